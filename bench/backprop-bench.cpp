@@ -0,0 +1,100 @@
+#include "../src/utils.h"
+#include "timer.h"
+#include <cstdio>
+
+// Compares expression::backpropagate() against the BFS it replaced,
+// which expands a node once per incoming edge, on chains of diamonds:
+//
+//     y = x*x; y = y*y; ... (depth times)
+//
+// The BFS expands 2^depth nodes (and over-counts the derivatives),
+// where backpropagate() expands depth.
+//
+// Then compares the dense adjoints of backpropagate() against the same
+// topological sweep with adjoints in a hash map keyed on vars, on wide
+// graphs: sum of x_i * x_{i+1} over n leaves, and against et::back()
+// over an index built once, which leaves out the hashing entirely.
+
+static void bfs(const et::var& root, std::unordered_map<et::var, double>& leaves){
+    std::queue<et::var> q;
+    std::unordered_map<et::var, double> derivatives;
+    q.push(root);
+    derivatives[root] = 1;
+    while(!q.empty()){
+        et::var v = q.front();
+        q.pop();
+        et::var::children_type& c = v.getChildren();
+        double d = derivatives[v];
+        derivatives[c[0]] += d * c[1].getValue();
+        derivatives[c[1]] += d * c[0].getValue();
+        for(size_t i = 0; i < 2; i++){
+            if(c[i].getOp() != et::op_type::none)
+                q.push(c[i]);
+        }
+    }
+    for(auto& iter : leaves)
+        iter.second = derivatives[iter.first];
+}
+
+static void hashed(const et::var& root, std::unordered_map<et::var, double>& leaves){
+    et::graph_index g(root);
+    std::unordered_map<et::var, double> derivatives;
+    derivatives[root] = 1;
+    for(uint32_t id = g.size(); id-- > 0;){
+        const et::var& v = g.getNode(id);
+        if(v.getOp() == et::op_type::none)
+            continue;
+        const et::var::children_type& c = v.getChildren();
+        double d = derivatives[v];
+        double lhs = c[0].getValue(), rhs = c.size() < 2 ? 0 : c[1].getValue();
+        for(size_t i = 0; i < c.size(); i++)
+            derivatives[c[i]] += d * et::_back_single(v.getOp(), lhs, rhs, i);
+    }
+    for(auto& iter : leaves)
+        iter.second = derivatives[iter.first];
+}
+
+int main(){
+    std::printf("%6s %14s %14s %16s\n", "depth", "bfs (ms)", "topo (ms)", "d/dx (topo)");
+    for(int depth = 4; depth <= 20; depth += 4){
+        et::var x(1);
+        et::var y = x * x;
+        for(int i = 1; i < depth; i++)
+            y = y * y;
+        et::expression exp(y);
+        exp.propagate();
+
+        std::unordered_map<et::var, double> m = { {x, 0} };
+        double t_bfs = time_ms([&]{ bfs(y, m); }, depth < 16 ? 100 : 1);
+        double t_topo = time_ms([&]{ exp.backpropagate(m); }, 100);
+        std::printf("%6d %14.4f %14.4f %16.0f\n", depth, t_bfs, t_topo, m[x]);
+    }
+
+    std::printf("\n%8s %14s %14s %14s\n", "leaves", "hashed (ms)", "dense (ms)", "prebuilt (ms)");
+    for(int n = 1000; n <= 100000; n *= 10){
+        std::vector<et::var> xs;
+        for(int i = 0; i < n; i++)
+            xs.push_back(et::var(i * 1e-3));
+        et::var y = xs[0] * xs[1];
+        for(int i = 1; i + 1 < n; i++)
+            y = y + xs[i] * xs[i+1];
+        et::expression exp(y);
+        exp.propagate();
+
+        std::unordered_map<et::var, double> m;
+        for(const et::var& x : xs)
+            m[x] = 0;
+        int reps = n < 100000 ? 20 : 3;
+        double t_hashed = time_ms([&]{ hashed(y, m); }, reps);
+        double t_dense = time_ms([&]{ exp.backpropagate(m); }, reps);
+
+        et::graph_index g(y);
+        std::vector<uint32_t> ids;
+        for(const et::var& x : xs)
+            ids.push_back(g.find(x));
+        std::vector<double> grad(n);
+        double t_prebuilt = time_ms([&]{ et::back(g, ids, grad.data()); }, reps);
+        std::printf("%8d %14.4f %14.4f %14.4f\n", n, t_hashed, t_dense, t_prebuilt);
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "../src/utils.h"
+#include "timer.h"
+#include <cstdio>
+#include <vector>
+
+// Evaluates the same expression over many input rows:
+// - one row at a time: setValue() on the leaves, then et::eval(),
+// - one row at a time through a compiled plan,
+// - all the rows at once through plan::eval(columns, rows, out).
+
+int main(){
+    et::var x(0), y(0);
+    et::var fx = x;
+    for(int i = 0; i < 8; i++)
+        fx = fx * y + x / (y + i) - et::exp(x * 0.01);
+    et::plan p = et::compile(fx);
+
+    std::printf("%10s %14s %14s %14s\n", "rows", "eval (ms)", "plan (ms)", "batch (ms)");
+    for(size_t rows = 1000; rows <= 1000000; rows *= 10){
+        std::vector<double> xs(rows), ys(rows), out(rows);
+        for(size_t i = 0; i < rows; i++){
+            xs[i] = i * 1e-6;
+            ys[i] = 1 + i * 1e-7;
+        }
+
+        double t_eval = time_ms([&]{
+            for(size_t i = 0; i < rows; i++){
+                x.setValue(xs[i]);
+                y.setValue(ys[i]);
+                out[i] = et::eval(fx);
+            }
+        });
+        double t_plan = time_ms([&]{
+            for(size_t i = 0; i < rows; i++){
+                x.setValue(xs[i]);
+                y.setValue(ys[i]);
+                out[i] = p.eval();
+            }
+        });
+        double t_batch = time_ms([&]{
+            p.eval({ {x, xs.data()}, {y, ys.data()} }, rows, out.data());
+        });
+        std::printf("%10zu %14.3f %14.3f %14.3f\n", rows, t_eval, t_plan, t_batch);
+    }
+    return 0;
+}
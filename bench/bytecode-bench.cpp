@@ -0,0 +1,46 @@
+#include "../src/bytecode.h"
+#include "../src/tape.h"
+#include "../src/utils.h"
+#include "timer.h"
+#include <cstdio>
+
+// Compares the interpreters for a graph of n operators:
+// - forward: et::eval(), plan::eval(), tape::forward(), bytecode::forward()
+// - reverse: tape::backward(), bytecode::backward()
+//
+// The tape is recorded from the same code as the graph, with tvars.
+
+template <typename T>
+static T build(T x, T y, int n){
+    T f = x;
+    for(int i = 0; i < n / 6; i++)
+        f = f * y + x / (y + i) - et::exp(x * 0.01);
+    return f;
+}
+
+int main(){
+    std::printf("%8s %12s %12s %12s %12s %12s %12s\n", "ops", "eval (us)", "plan (us)",
+            "tape (us)", "vm (us)", "tape b. (us)", "vm b. (us)");
+    for(int n = 60; n <= 600000; n *= 10){
+        int reps = 6000000 / n;
+
+        et::var x(0.5), y(1.5);
+        et::var f = build(x, y, n);
+        et::plan p = et::compile(f);
+        et::bytecode code(f);
+
+        et::tape t;
+        et::tvar tx = t.variable(0.5), ty = t.variable(1.5);
+        et::tvar tf = build(tx, ty, n);
+
+        double t_eval = time_us([&]{ et::eval(f); }, reps);
+        double t_plan = time_us([&]{ p.eval(); }, reps);
+        double t_tape = time_us([&]{ t.forward(); }, reps);
+        double t_vm = time_us([&]{ code.forward(); }, reps);
+        double t_tape_back = time_us([&]{ t.backward(tf); }, reps);
+        double t_vm_back = time_us([&]{ code.backward(); }, reps);
+        std::printf("%8d %12.2f %12.2f %12.2f %12.2f %12.2f %12.2f\n",
+                n, t_eval, t_plan, t_tape, t_vm, t_tape_back, t_vm_back);
+    }
+    return 0;
+}
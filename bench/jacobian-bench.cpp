@@ -0,0 +1,41 @@
+#include "../src/utils.h"
+#include "timer.h"
+#include <cstdio>
+
+// Compares et::jacobian() against one et::back() per root, on graphs
+// where every output depends on a shared trunk over all of the inputs:
+//
+//     t = sum of x_i * x_{i+1}
+//     y_k = t * x_{k mod n} + exp(x_{3k mod n}) / (k + 1)
+//
+// Both modes are timed, with as many inputs as outputs, and with
+// either side ten times wider than the other.
+
+int main(){
+    std::printf("%6s %7s %14s %14s %14s\n", "inputs", "outputs", "back (ms)", "reverse (ms)", "forward (ms)");
+    const int shapes[][2] = { {50, 500}, {200, 200}, {500, 50} };
+    for(const auto& shape : shapes){
+        int n = shape[0], m = shape[1];
+        std::vector<et::var> xs;
+        for(int i = 0; i < n; i++)
+            xs.push_back(et::var(1 + i * 1e-3));
+        et::var t = xs[0] * xs[1];
+        for(int i = 1; i < n; i++)
+            t = t + xs[i] * xs[(i + 1) % n];
+        std::vector<et::var> ys;
+        for(int k = 0; k < m; k++)
+            ys.push_back(t * xs[k % n] + et::exp(xs[(3 * k) % n]) / (k + 1));
+
+        std::vector<double> grad(n);
+        double t_back = time_ms([&]{
+            for(et::var& y : ys){
+                et::eval(y);
+                et::back(y, xs, grad.data());
+            }
+        }, 3);
+        double t_rev = time_ms([&]{ et::jacobian(ys, xs, et::jacobian_mode::reverse); }, 3);
+        double t_fwd = time_ms([&]{ et::jacobian(ys, xs, et::jacobian_mode::forward); }, 3);
+        std::printf("%6d %7d %14.3f %14.3f %14.3f\n", n, m, t_back, t_rev, t_fwd);
+    }
+    return 0;
+}
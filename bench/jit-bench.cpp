@@ -0,0 +1,51 @@
+#include "../src/jit.h"
+#include "timer.h"
+#include <cstdio>
+#include <string>
+#include <unistd.h>
+
+// For graphs of n operators, times:
+// - building the native code (cold cache) and loading it (warm cache),
+// - forward() and backward() natively, against the bytecode interpreter.
+
+static et::var build(et::var x, et::var y, int n){
+    et::var f = x;
+    for(int i = 0; i < n / 6; i++)
+        f = f * y + x / (y + i) - et::exp(x * 0.01);
+    return f;
+}
+
+int main(){
+    et::jit_options options;
+    options.cache_dir = "/tmp/et-jit-bench-" + std::to_string(getpid());
+
+    std::printf("%8s %12s %12s %10s %10s %10s %10s\n", "ops", "build (ms)", "load (ms)",
+            "vm (us)", "jit (us)", "vm b. (us)", "jit b. (us)");
+    // Building gets slow quickly: 6000 operators take close to a minute at -O2.
+    for(int n = 60; n <= 600; n *= 10){
+        int reps = 6000000 / n;
+        et::var x(0.5), y(1.5);
+        et::var f = build(x, y, n);
+        et::bytecode code(f);
+
+        et::jit_function* fn = nullptr;
+        double t_build = time_us([&]{ fn = new et::jit_function(f, options); }, 1) / 1000;
+        if(!fn->isNative()){
+            std::printf("no compiler available: %s\n", options.compiler.c_str());
+            return 1;
+        }
+        double t_load = time_us([&]{ et::jit_function again(f, options); }, 1) / 1000;
+
+        double t_vm = time_us([&]{ code.forward(); }, reps);
+        double t_jit = time_us([&]{ fn->forward(); }, reps);
+        double t_vm_back = time_us([&]{ code.backward(); }, reps);
+        double t_jit_back = time_us([&]{ fn->backward(); }, reps);
+        std::printf("%8d %12.1f %12.3f %10.2f %10.2f %10.2f %10.2f\n",
+                n, t_build, t_load, t_vm, t_jit, t_vm_back, t_jit_back);
+
+        std::remove(fn->getLibraryPath().c_str());
+        delete fn;
+    }
+    rmdir(options.cache_dir.c_str());
+    return 0;
+}
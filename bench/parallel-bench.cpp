@@ -0,0 +1,52 @@
+#include "../src/utils.h"
+#include "timer.h"
+#include <cstdio>
+#include <vector>
+
+// Compares the serial evaluation of a wide graph with the level
+// scheduled and the work-stealing ones, for pools of increasing size.
+//
+// The graph is `width` independent sub-expressions of `depth`
+// operators each, over a shared x, summed pairwise at the end.
+
+static et::var wide(et::var& x, int width, int depth){
+    std::vector<et::var> terms;
+    for(int i = 0; i < width; i++){
+        et::var t = x + i;
+        for(int d = 1; d < depth; d++)
+            t = d % 2 ? t * x : t / (x + 1);
+        terms.push_back(t);
+    }
+    while(terms.size() > 1){
+        std::vector<et::var> sums;
+        for(size_t i = 0; i + 1 < terms.size(); i += 2)
+            sums.push_back(terms[i] + terms[i+1]);
+        if(terms.size() % 2)
+            sums.push_back(terms.back());
+        terms = sums;
+    }
+    return terms[0];
+}
+
+int main(){
+    unsigned cores = std::thread::hardware_concurrency();
+    std::printf("hardware threads: %u\n", cores);
+    std::printf("%8s %6s %12s %8s %12s %14s %14s\n", "width", "depth", "serial (ms)",
+            "threads", "levels (ms)", "stealing (ms)", "back st. (ms)");
+    for(int width = 1000; width <= 100000; width *= 10){
+        et::var x(0.5);
+        et::var root = wide(x, width, 8);
+        et::graph_index g(root);
+        et::level_schedule s(g);
+        double serial = time_ms([&]{ et::eval(root); }, 10);
+        for(unsigned threads = 1; threads <= (cores > 1 ? cores : 1); threads *= 2){
+            et::thread_pool pool(threads);
+            double levels = time_ms([&]{ et::propagate_levels(g, s, pool); }, 10);
+            double stealing = time_ms([&]{ et::propagate_stealing(g, pool); }, 10);
+            double back = time_ms([&]{ et::backpropagate_stealing(g, pool); }, 10);
+            std::printf("%8d %6d %12.3f %8u %12.3f %14.3f %14.3f\n",
+                    width, 8, serial, threads, levels, stealing, back);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "../src/static_expr.h"
+#include "../src/utils.h"
+#include "timer.h"
+#include <cstdio>
+
+// A small pricing-like formula over three inputs (spot, rate, time),
+// evaluated and differentiated for many input points:
+// - dynamic: an et::var graph built once, then setValue(), et::eval()
+//   and et::back() for every point,
+// - dynamic, rebuilt: the graph is built again for every point,
+// - static: the same formula as an expression template.
+
+template <typename S, typename R, typename T>
+static auto formula(const S& s, const R& r, const T& t) -> decltype(s * et::exp(r * t) / (1 + s * t) + et::poly(s, 2) * t - r / (t + 1)){
+    return s * et::exp(r * t) / (1 + s * t) + et::poly(s, 2) * t - r / (t + 1);
+}
+
+int main(){
+    const int points = 1000000;
+    double checksum[3] = {0, 0, 0};
+
+    double t_dynamic = time_ms([&]{
+        et::var s(0), r(0), t(0);
+        et::var f = formula(s, r, t);
+        std::unordered_map<et::var, double> grad = { {s, 0}, {r, 0}, {t, 0} };
+        for(int i = 0; i < points; i++){
+            s.setValue(100 + i * 1e-4);
+            r.setValue(0.05);
+            t.setValue(1 + i * 1e-6);
+            checksum[0] += et::eval(f);
+            et::back(f, grad);
+            checksum[0] += grad[s];
+        }
+    });
+
+    double t_rebuilt = time_ms([&]{
+        for(int i = 0; i < points; i++){
+            et::var s(100 + i * 1e-4), r(0.05), t(1 + i * 1e-6);
+            et::var f = formula(s, r, t);
+            std::unordered_map<et::var, double> grad = { {s, 0}, {r, 0}, {t, 0} };
+            checksum[1] += et::eval(f);
+            et::back(f, grad);
+            checksum[1] += grad[s];
+        }
+    });
+
+    double t_static = time_ms([&]{
+        et::static_var<0> s;
+        et::static_var<1> r;
+        et::static_var<2> t;
+        auto f = formula(s, r, t);
+        for(int i = 0; i < points; i++){
+            double in[3] = {100 + i * 1e-4, 0.05, 1 + i * 1e-6};
+            double grad[3] = {0, 0, 0};
+            checksum[2] += et::back(f, in, grad);
+            checksum[2] += grad[0];
+        }
+    });
+
+    std::printf("%d points, value and gradient\n", points);
+    std::printf("%20s %12s %20s\n", "", "time (ms)", "checksum");
+    std::printf("%20s %12.2f %20.6f\n", "dynamic", t_dynamic, checksum[0]);
+    std::printf("%20s %12.2f %20.6f\n", "dynamic, rebuilt", t_rebuilt, checksum[1]);
+    std::printf("%20s %12.2f %20.6f\n", "static", t_static, checksum[2]);
+    return 0;
+}
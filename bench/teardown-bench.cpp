@@ -0,0 +1,53 @@
+#include "../src/var.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Times the destruction of graphs of various shapes and sizes,
+// from the moment the last var referring to the root goes away.
+//
+// - chain: exp(exp(...exp(x))), as deep as it is large.
+// - recurrence: x_{t+1} = x_t + h * x_t, where every step is shared.
+// - wide: the sum of n distinct leaves, built left to right.
+
+static et::var chain(int n){
+    et::var root(1);
+    for(int i = 1; i < n; i++)
+        root = et::exp(root);
+    return root;
+}
+
+static et::var recurrence(int n){
+    et::var h(1e-6);
+    et::var root(1);
+    for(int i = 0; i < n / 3; i++)
+        root = root + h * root;
+    return root;
+}
+
+static et::var wide(int n){
+    et::var root(0);
+    for(int i = 1; i < n / 2; i++)
+        root = root + et::var(i);
+    return root;
+}
+
+template <typename F>
+static double teardown_ms(F build, int n){
+    et::var* root = new et::var(build(n));
+    auto start = std::chrono::steady_clock::now();
+    delete root;
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(){
+    std::printf("%10s %14s %14s %14s\n", "nodes", "chain (ms)", "recur. (ms)", "wide (ms)");
+    for(int n = 1000; n <= 10000000; n *= 10){
+        std::printf("%10d %14.3f %14.3f %14.3f\n", n,
+                teardown_ms(chain, n),
+                teardown_ms(recurrence, n),
+                teardown_ms(wide, n));
+    }
+    return 0;
+}
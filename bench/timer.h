@@ -0,0 +1,27 @@
+#pragma once
+
+#include <chrono>
+#include <ratio>
+
+// Timing helpers shared by the benchmarks.
+
+// Average wall time of one of reps calls to f, in units of Period
+// (std::milli for milliseconds, std::micro for microseconds).
+template <typename Period, typename F>
+inline double time_per_call(F f, int reps){
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < reps; i++)
+        f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, Period>(end - start).count() / reps;
+}
+
+template <typename F>
+inline double time_ms(F f, int reps = 1){
+    return time_per_call<std::milli>(f, reps);
+}
+
+template <typename F>
+inline double time_us(F f, int reps = 1){
+    return time_per_call<std::micro>(f, reps);
+}
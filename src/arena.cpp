@@ -0,0 +1,169 @@
+#include "arena.h"
+#include <cstdint>
+
+namespace et{
+
+struct arena_state {
+    size_t block_size;
+    std::vector<char*> blocks;
+    char* cur;
+    size_t left;
+
+    size_t used;
+    size_t live;
+    // Set once the graph_arena scope has ended. The state deletes
+    // itself when the last live allocation is given back.
+    bool orphaned;
+
+    ~arena_state(){
+        for(char* block : blocks)
+            delete[] block;
+    }
+};
+
+static thread_local graph_arena* current_arena = nullptr;
+
+namespace{
+
+const size_t pool_granularity = 16;
+const size_t pool_classes = 16;
+
+struct free_block {
+    free_block* next;
+};
+
+struct node_pool {
+    free_block* lists[pool_classes];
+    size_t sizes[pool_classes];
+    size_t cached;
+
+    node_pool() : lists(), sizes(), cached(0){}
+    ~node_pool();
+
+    void trim(){
+        for(free_block*& head : lists){
+            while(head){
+                free_block* next = head->next;
+                ::operator delete(head);
+                head = next;
+            }
+        }
+        for(size_t& n : sizes)
+            n = 0;
+        cached = 0;
+    }
+};
+
+thread_local node_pool pool;
+// Nodes may still be released after the pool is gone at thread
+// exit (e.g. vars with static storage), which must bypass it.
+thread_local bool pool_destroyed = false;
+
+node_pool::~node_pool(){
+    trim();
+    pool_destroyed = true;
+}
+
+size_t size_class(size_t bytes){
+    return bytes == 0 ? 1 : (bytes + pool_granularity - 1) / pool_granularity;
+}
+
+}
+
+// A pooled block always has the full size of its class, even when it
+// bypasses the pool: another thread may put it on its free list.
+void* pool_allocate(size_t bytes){
+    size_t c = size_class(bytes);
+    if(c > pool_classes)
+        return ::operator new(bytes);
+    if(pool_destroyed)
+        return ::operator new(c * pool_granularity);
+    free_block*& head = pool.lists[c-1];
+    if(head == nullptr)
+        return ::operator new(c * pool_granularity);
+    free_block* block = head;
+    head = block->next;
+    pool.sizes[c-1]--;
+    pool.cached--;
+    return block;
+}
+
+// Once a free list is full, blocks go back to the global heap. This
+// bounds what a thread that only frees nodes built by others keeps.
+void pool_deallocate(void* p, size_t bytes){
+    size_t c = size_class(bytes);
+    if(c > pool_classes || pool_destroyed || pool.sizes[c-1] >= node_pool_limit){
+        ::operator delete(p);
+        return;
+    }
+    free_block* block = static_cast<free_block*>(p);
+    block->next = pool.lists[c-1];
+    pool.lists[c-1] = block;
+    pool.sizes[c-1]++;
+    pool.cached++;
+}
+
+size_t node_pool_size(){ return pool_destroyed ? 0 : pool.cached; }
+
+void trim_node_pool(){
+    if(!pool_destroyed)
+        pool.trim();
+}
+
+void* arena_allocate(arena_state* s, size_t bytes, size_t align){
+    uintptr_t p = reinterpret_cast<uintptr_t>(s->cur);
+    size_t pad = (align - p % align) % align;
+    if(s->cur == nullptr || pad + bytes > s->left){
+        // Oversized requests get a block of their own.
+        size_t size = bytes + align > s->block_size ? bytes + align : s->block_size;
+        s->blocks.push_back(new char[size]);
+        s->cur = s->blocks.back();
+        s->left = size;
+        p = reinterpret_cast<uintptr_t>(s->cur);
+        pad = (align - p % align) % align;
+    }
+    char* res = s->cur + pad;
+    s->cur = res + bytes;
+    s->left -= pad + bytes;
+    s->used += bytes;
+    s->live++;
+    return res;
+}
+
+void arena_deallocate(arena_state* s, void*){
+    s->live--;
+    if(s->orphaned && s->live == 0)
+        delete s;
+}
+
+/* et::graph_arena funcs: */
+const size_t graph_arena::default_block_size;
+
+graph_arena::graph_arena(size_t block_size)
+: state(new arena_state()), prev(current_arena){
+    state->block_size = block_size;
+    state->cur = nullptr;
+    state->left = 0;
+    state->used = 0;
+    state->live = 0;
+    state->orphaned = false;
+    current_arena = this;
+}
+
+graph_arena::~graph_arena(){
+    current_arena = prev;
+    if(state->live == 0)
+        delete state;
+    else
+        state->orphaned = true;
+}
+
+graph_arena* graph_arena::current(){ return current_arena; }
+
+arena_state* graph_arena::getState() const{ return state; }
+
+size_t graph_arena::getBytesUsed() const{ return state->used; }
+
+size_t graph_arena::getLiveCount() const{ return state->live; }
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace et{
+// The bookkeeping of an arena. It is kept separately from the
+// graph_arena scope object, because nodes are allowed to outlive
+// the scope they were created in (see below).
+struct arena_state;
+
+void* arena_allocate(arena_state*, size_t bytes, size_t align);
+void arena_deallocate(arena_state*, void*);
+
+/**
+ * A graph_arena is a scope object. While it is alive, every et::var
+ * node created on the same thread is bump-allocated out of a few large
+ * blocks owned by the arena, instead of going through malloc once per node.
+ *
+ * When the arena goes out of scope the blocks are released in one shot.
+ * Destroying the nodes themselves never frees anything.
+ *
+ * ::Example::
+ *
+ * for(int i = 0; i < iterations; i++){
+ *     et::graph_arena arena;
+ *     et::var loss = build_model(inputs);
+ *     et::eval(loss, true);
+ *     et::back(loss, grads);
+ * } // the whole graph is released here
+ *
+ * Arenas nest: the innermost one is used, and the enclosing one
+ * becomes current again once it is gone.
+ *
+ * If some nodes are still referenced when the scope ends (e.g. a var
+ * was returned out of it), the blocks are kept until the last of those
+ * nodes dies, so holding on to a var is never a dangling reference.
+ * Nodes must be destroyed on the thread that created them.
+ */
+class graph_arena {
+public:
+    static const size_t default_block_size = 1 << 16;
+
+    explicit graph_arena(size_t block_size = default_block_size);
+    ~graph_arena();
+
+    graph_arena(const graph_arena&) = delete;
+    graph_arena& operator=(const graph_arena&) = delete;
+
+    // The innermost arena alive on this thread, or nullptr.
+    static graph_arena* current();
+    arena_state* getState() const;
+
+    // Number of bytes handed out, and number of allocations
+    // that have not been given back yet.
+    size_t getBytesUsed() const;
+    size_t getLiveCount() const;
+
+private:
+    arena_state* state;
+    graph_arena* prev;
+};
+
+/**
+ * Nodes that do not live in an arena come from a per-thread pool of
+ * free lists, one per size class (multiples of 16 bytes, up to 256).
+ * A released node goes back to the free list of the thread releasing
+ * it, and the next node of that size is taken from there. So a loop
+ * that keeps building and discarding graphs of the same shape stops
+ * calling into the global allocator after the first iteration.
+ *
+ * Larger requests go straight to the global heap, and so do blocks
+ * released while their free list already holds node_pool_limit blocks:
+ * a thread that frees graphs built by other threads only keeps up to
+ * that many blocks per size class.
+ */
+const size_t node_pool_limit = 1 << 14;
+
+void* pool_allocate(size_t bytes);
+void pool_deallocate(void*, size_t bytes);
+
+// Number of blocks cached in this thread's free lists.
+size_t node_pool_size();
+// Gives every block cached by this thread back to the global heap.
+// This also happens when the thread exits.
+void trim_node_pool();
+
+/**
+ * A std::allocator compatible allocator that takes its memory from
+ * an arena if it was given one, and from the node pool otherwise.
+ * Nodes remember which arena they came from, so they can be given back.
+ */
+template <typename T>
+struct node_allocator {
+    typedef T value_type;
+
+    node_allocator(arena_state* _arena = nullptr) : arena(_arena){}
+
+    template <typename U>
+    node_allocator(const node_allocator<U>& other) : arena(other.arena){}
+
+    T* allocate(size_t n){
+        if(arena)
+            return static_cast<T*>(arena_allocate(arena, n * sizeof(T), alignof(T)));
+        return static_cast<T*>(pool_allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n){
+        if(arena)
+            arena_deallocate(arena, p);
+        else
+            pool_deallocate(p, n * sizeof(T));
+    }
+
+    arena_state* arena;
+};
+
+template <typename T, typename U>
+bool operator==(const node_allocator<T>& lhs, const node_allocator<U>& rhs){
+    return lhs.arena == rhs.arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const node_allocator<T>& lhs, const node_allocator<U>& rhs){
+    return !(lhs == rhs);
+}
+
+}
@@ -0,0 +1,159 @@
+#include "bytecode.h"
+#include "kernels.h"
+#include <cmath>
+#include <stdexcept>
+
+// Threaded dispatch: every instruction ends with its own jump to the
+// next one, through a table of label addresses (a GNU extension).
+// Elsewhere (or with ET_NO_COMPUTED_GOTO), the same handlers are the
+// cases of a switch in a loop.
+#if defined(__GNUC__) && !defined(ET_NO_COMPUTED_GOTO)
+ #define ET_COMPUTED_GOTO
+#endif
+
+#ifdef ET_COMPUTED_GOTO
+ #define VM_DISPATCH goto *labels[static_cast<int>(ip->op)];
+ #define VM_CASE(name) op_##name:
+ #define VM_NEXT(step) ip += step; goto *labels[static_cast<int>(ip->op)];
+#else
+ #define VM_DISPATCH for(;;) switch(ip->op)
+ #define VM_CASE(name) case opcode::name:
+ #define VM_NEXT(step) ip += step; continue;
+#endif
+
+namespace et{
+
+namespace{
+
+opcode to_opcode(op_type op){
+    switch(op){
+        case op_type::plus: return opcode::add;
+        case op_type::minus: return opcode::sub;
+        case op_type::multiply: return opcode::mul;
+        case op_type::divide: return opcode::div;
+        case op_type::exponent: return opcode::exp;
+        case op_type::polynomial: return opcode::pow;
+        default:
+            throw std::invalid_argument("Cannot have a non-leaf contain none-op.");
+    }
+}
+
+}
+
+bytecode::bytecode(const var& root) : index(root){
+    code.reserve(index.size() + 2);
+    code.push_back(instruction{opcode::halt, 0, 0, 0});
+    for(uint32_t id = 0; id < index.size(); id++){
+        const uint32_t* c = index.childrenBegin(id);
+        switch(index.childrenEnd(id) - c){
+            case 0:
+                leaves.push_back(id);
+                break;
+            case 1:
+                code.push_back(instruction{to_opcode(index.getNode(id).getOp()), id, c[0], c[0]});
+                break;
+            case 2:
+                code.push_back(instruction{to_opcode(index.getNode(id).getOp()), id, c[0], c[1]});
+                break;
+            default:
+                throw std::invalid_argument("et::bytecode only supports unary and binary operators.");
+        }
+    }
+    code.push_back(instruction{opcode::halt, 0, 0, 0});
+    registers.resize(index.size());
+}
+
+double bytecode::forward(){
+    for(uint32_t id : leaves)
+        registers[id] = index.getNode(id).getValue();
+
+    double* r = registers.data();
+    const instruction* ip = code.data() + 1;
+#ifdef ET_COMPUTED_GOTO
+    // In the order of et::opcode.
+    static const void* const labels[] = {
+        &&op_halt, &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_exp, &&op_pow
+    };
+#endif
+    VM_DISPATCH{
+        VM_CASE(add) r[ip->dst] = r[ip->lhs] + r[ip->rhs]; VM_NEXT(1)
+        VM_CASE(sub) r[ip->dst] = r[ip->lhs] - r[ip->rhs]; VM_NEXT(1)
+        VM_CASE(mul) r[ip->dst] = r[ip->lhs] * r[ip->rhs]; VM_NEXT(1)
+        VM_CASE(div) r[ip->dst] = r[ip->lhs] / r[ip->rhs]; VM_NEXT(1)
+        VM_CASE(exp) r[ip->dst] = std::exp(r[ip->lhs]); VM_NEXT(1)
+        VM_CASE(pow) r[ip->dst] = std::pow(r[ip->lhs], r[ip->rhs]); VM_NEXT(1)
+        VM_CASE(halt) goto done;
+    }
+done:
+    return registers.back();
+}
+
+// The backward step of one instruction. op is a constant at every call
+// site, so the switch of _back_fused folds away, and the VM shares its
+// partials with every other evaluator.
+static inline void back_step(op_type op, const instruction* ip, const double* r, double* a){
+    _back_fused(op, r[ip->lhs], r[ip->rhs], r[ip->dst], a[ip->dst], a[ip->lhs], a[ip->rhs]);
+}
+
+// Walks the instructions backwards from the root, so that every
+// register has all of its contributions before it is passed on.
+void bytecode::backward(){
+    adjoints.assign(registers.size(), 0);
+    adjoints.back() = 1;
+
+    const double* r = registers.data();
+    double* a = adjoints.data();
+    const instruction* ip = code.data() + code.size() - 2;
+#ifdef ET_COMPUTED_GOTO
+    static const void* const labels[] = {
+        &&op_halt, &&op_add, &&op_sub, &&op_mul, &&op_div, &&op_exp, &&op_pow
+    };
+#endif
+    VM_DISPATCH{
+        VM_CASE(add) back_step(op_type::plus, ip, r, a); VM_NEXT(-1)
+        VM_CASE(sub) back_step(op_type::minus, ip, r, a); VM_NEXT(-1)
+        VM_CASE(mul) back_step(op_type::multiply, ip, r, a); VM_NEXT(-1)
+        VM_CASE(div) back_step(op_type::divide, ip, r, a); VM_NEXT(-1)
+        VM_CASE(exp) back_step(op_type::exponent, ip, r, a); VM_NEXT(-1)
+        VM_CASE(pow) back_step(op_type::polynomial, ip, r, a); VM_NEXT(-1)
+        VM_CASE(halt) goto done;
+    }
+done:
+    return;
+}
+
+size_t bytecode::numRegisters() const{ return registers.size(); }
+
+size_t bytecode::size() const{ return code.size() - 2; }
+
+const std::vector<instruction>& bytecode::getCode() const{ return code; }
+
+const graph_index& bytecode::getIndex() const{ return index; }
+
+const std::vector<uint32_t>& bytecode::getLeaves() const{ return leaves; }
+
+double bytecode::getValue(const var& v) const{
+    return registers[registerOf(v)];
+}
+
+double bytecode::getDerivative(const var& v) const{
+    uint32_t id = registerOf(v);
+    return id < adjoints.size() ? adjoints[id] : 0;
+}
+
+const std::vector<double>& bytecode::getRegisters() const{ return registers; }
+
+const std::vector<double>& bytecode::getAdjoints() const{ return adjoints; }
+
+uint32_t bytecode::registerOf(const var& v) const{
+    uint32_t id = index.find(v);
+    if(id == graph_index::npos)
+        throw std::invalid_argument("The var is not part of the compiled graph.");
+    return id;
+}
+
+}
+
+#undef VM_DISPATCH
+#undef VM_CASE
+#undef VM_NEXT
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "graph.h"
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace et{
+
+// The instruction set of et::bytecode. halt ends a pass.
+enum class opcode : uint8_t {halt, add, sub, mul, div, exp, pow};
+
+// One instruction: registers[dst] = registers[lhs] op registers[rhs].
+// Unary instructions ignore rhs.
+struct instruction {
+    opcode op;
+    uint32_t dst;
+    uint32_t lhs;
+    uint32_t rhs;
+};
+
+static_assert(std::is_trivially_copyable<instruction>::value, "instructions must stay plain data.");
+static_assert(sizeof(instruction) == 16, "instructions must stay 16 bytes wide.");
+
+/**
+ * An et::var graph compiled to bytecode for a small register machine.
+ *
+ * Every node of the graph gets a register, numbered like the ids of an
+ * et::graph_index, and every operator becomes one instruction reading
+ * and writing registers. forward() runs the instructions in order and
+ * backward() runs them in reverse, each in a tight interpreter loop
+ * over a flat array of instructions. Where the compiler supports it
+ * (GCC and clang), dispatch uses computed gotos, with one indirect
+ * jump per instruction instead of going back through a switch.
+ *
+ * Like et::plan, the bytecode keeps the graph alive, reads the
+ * current values of the leaves on every forward(), and keeps the
+ * results in its registers rather than writing them back to the graph.
+ *
+ * ::Example::
+ *
+ * et::var x(1), y(2);
+ * et::var f = x * y + et::exp(x);
+ * et::bytecode b(f);
+ *
+ * b.forward(); // returns 2 + e
+ * b.backward();
+ * b.getDerivative(x); // returns 2 + e
+ */
+class bytecode {
+public:
+    explicit bytecode(const var& root);
+
+    // Loads the leaves, runs every instruction, and returns the
+    // value of the root.
+    double forward();
+
+    // Computes the derivative of the root w.r.t. every register,
+    // from the values of the last forward().
+    void backward();
+
+    // Number of registers (one per node) and of instructions
+    // (one per operator, not counting the halts).
+    size_t numRegisters() const;
+    size_t size() const;
+
+    // The instructions, framed by a halt on either side.
+    const std::vector<instruction>& getCode() const;
+
+    // The graph the registers are numbered after, and the
+    // registers that are loaded from its leaves.
+    const graph_index& getIndex() const;
+    const std::vector<uint32_t>& getLeaves() const;
+
+    // Values and derivatives of the nodes, as of the last
+    // forward() and backward().
+    double getValue(const var&) const;
+    double getDerivative(const var&) const;
+    const std::vector<double>& getRegisters() const;
+    const std::vector<double>& getAdjoints() const;
+
+private:
+    uint32_t registerOf(const var&) const;
+
+    graph_index index;
+    std::vector<uint32_t> leaves;
+    std::vector<instruction> code;
+    std::vector<double> registers;
+    std::vector<double> adjoints;
+};
+
+}
@@ -4,85 +4,47 @@
 
 namespace et{
 
-// Helper function for recursive propagation
-double _eval(op_type op, const std::vector<var>& operands){
+// Column kernel for the forward pass: out[i] = lhs[i] op rhs[i].
+// Each case is a plain loop over contiguous arrays, so that the compiler
+// can vectorize it for whatever SIMD width the target has.
+// Unary operators ignore rhs, which may then be null.
+void _eval_batch(op_type op, const double* __restrict__ lhs, const double* __restrict__ rhs,
+        double* __restrict__ out, size_t n){
     switch(op){
         case op_type::plus:
-            return operands[0].getValue() + operands[1].getValue();
+            for(size_t i = 0; i < n; i++)
+                out[i] = lhs[i] + rhs[i];
+            break;
         case op_type::minus:
-            return operands[0].getValue() - operands[1].getValue();
+            for(size_t i = 0; i < n; i++)
+                out[i] = lhs[i] - rhs[i];
+            break;
         case op_type::multiply:
-            return operands[0].getValue() * operands[1].getValue();
+            for(size_t i = 0; i < n; i++)
+                out[i] = lhs[i] * rhs[i];
+            break;
         case op_type::divide:
-            return operands[0].getValue() / operands[1].getValue();
+            for(size_t i = 0; i < n; i++)
+                out[i] = lhs[i] / rhs[i];
+            break;
         case op_type::exponent:
-            return std::exp(operands[0].getValue());
+            for(size_t i = 0; i < n; i++)
+                out[i] = std::exp(lhs[i]);
+            break;
         case op_type::polynomial:
-            return std::pow(operands[0].getValue(), operands[1].getValue());
+            for(size_t i = 0; i < n; i++)
+                out[i] = std::pow(lhs[i], rhs[i]);
+            break;
         case op_type::none:
             throw std::invalid_argument("Cannot have a non-leaf contain none-op.");
-    }; 
+    };
 }
 
-// Helper function for recursive backpropagation
-double _back_single(op_type op, 
-        const std::vector<var>& operands,
-        int op_idx){
-    switch(op){
-        case op_type::plus: {
-            return 1;
-        }
-        case op_type::minus: {
-            if(op_idx == 0)
-                return 1;
-            else
-                return -1;
-        }
-        case op_type::multiply: {
-            return operands[(1-op_idx)].getValue();
-        }
-        case op_type::divide: {
-            if(op_idx == 0)
-                return 1 / operands[1].getValue();
-            else
-                return -operands[0].getValue() / std::pow(operands[1].getValue(), 2);
-        }
-        case op_type::exponent: {
-            return std::exp(operands[0].getValue());
-        }
-        case op_type::polynomial: {
-            if(op_idx == 0)
-                return std::pow(operands[0].getValue(), operands[1].getValue()-1) * 
-                    operands[1].getValue();
-            else
-                return 0; // we don't support exponents other than e.
-        }
-        case op_type::none: {
-            throw std::invalid_argument("Cannot have a non-leaf contain none-op.");
-        }
-    }; 
-}
-
-std::vector<double> _back(op_type op, const std::vector<var>& operands,
-        const std::vector<bool>& nonconsts,
-        double dx){
-    std::vector<double> derivatives;
-    for(size_t i = 0; i < operands.size(); i++){
-        if(!nonconsts[i])
-            derivatives.push_back(0); // no gradient flow.
-        else
-            derivatives.push_back(dx * _back_single(op, operands, i));
-    }
-    return derivatives;
-}
-
-std::vector<double> _back(op_type op, const std::vector<var>& operands,
-        double dx){
-    std::vector<double> derivatives;
-    for(size_t i = 0; i < operands.size(); i++){
-        derivatives.push_back(dx * _back_single(op, operands, i));
-    }
-    return derivatives;
+// Helper function for recursive propagation
+double _eval(op_type op, const var::children_type& operands){
+    return _eval(op, 
+            operands.empty() ? 0 : operands[0].getValue(),
+            operands.size() < 2 ? 0 : operands[1].getValue());
 }
 
 expression::expression(var _root) : root(_root){}
@@ -101,7 +63,7 @@ std::vector<var> expression::findLeaves(){
         if(v.getChildren().empty())
             leaves.push_back(v);
         else{
-            std::vector<var> children = v.getChildren();
+            const var::children_type& children = v.getChildren();
             for(const var& v : children){
                 q.push(v);
             }
@@ -111,29 +73,56 @@ std::vector<var> expression::findLeaves(){
     return leaves;
 }
 
-void _rpropagate(var& v){
-    if(v.getChildren().empty())
-        return;
-    std::vector<var> children = v.getChildren(); 
-    for(var& _v : children){
-        _rpropagate(_v);
-    }
-    v.setValue(_eval(v.getOp(), v.getChildren()));
-}
+// A post-order DFS, with the call stack replaced by an explicit one:
+// each frame holds a node and the next of its children to descend into.
+// Nodes reachable through several paths are only evaluated
+// the first time they are reached in this epoch.
+//
+// The stack is kept around between calls, so evaluating a small graph
+// again does not allocate. Past max_kept_frames, it is freed again,
+// so that one very deep graph does not pin its stack to the thread.
+static const size_t max_kept_frames = 1 << 12;
 
 double expression::propagate(){
-    _rpropagate(root);
+    static thread_local std::vector<std::pair<var*, size_t>> stack;
+    uint64_t epoch = var::newEpoch();
+    stack.clear();
+    if(!root.getChildren().empty() && !root.visit(epoch))
+        stack.emplace_back(&root, 0);
+
+    while(!stack.empty()){
+        var& v = *stack.back().first;
+        var::children_type& children = v.getChildren();
+        size_t& next = stack.back().second;
+
+        // Skip over the children that are ready, and descend
+        // into the first one that is not.
+        var* pending = nullptr;
+        while(next < children.size() && !pending){
+            var& child = children[next++];
+            if(!child.getChildren().empty() && !child.visit(epoch))
+                pending = &child;
+        }
+        if(pending)
+            stack.emplace_back(pending, 0);
+        else{
+            v.setValue(_eval(v.getOp(), children));
+            stack.pop_back();
+        }
+    }
+    if(stack.capacity() > max_kept_frames)
+        std::vector<std::pair<var*, size_t>>().swap(stack);
     return root.getValue();
 }
 
 // This one is a little tougher:
 // We want to create a queue for which can be parallelized;
 // A node is "available" if it has all of its children loaded.
-// Currently, we wrap around the vars, and add a field
-// that tracks how many occurences of its children we found.
+// Nodes do not know their parents, so we first index the graph,
+// and track how many occurences of its children we found by id.
 //
 // Pseudocode:
-// suppose q has all the leaves, and m contains <var, int>
+// suppose q has all the leaves, and m contains <id, int>
 // while q not empty:
 //     v = q.pop
 //     evaluate v
@@ -145,114 +134,144 @@ double expression::propagate(){
 // return root.val
 
 double expression::propagate(const std::vector<var>& leaves){
-    std::queue<var> q;
-    std::unordered_map<var, int> explored; 
-    for(const var& v : leaves)
-        q.push(v);
+    graph_index g(root);
+    std::queue<uint32_t> q;
+    std::vector<int> explored(g.size(), 0);
+    std::vector<bool> queued(g.size(), false);
+    for(const var& v : leaves){
+        // Leaves may be listed more than once (findLeaves() does
+        // that for shared leaves), but must only be expanded once.
+        uint32_t id = g.find(v);
+        if(id != graph_index::npos && !queued[id]){
+            queued[id] = true;
+            q.push(id);
+        }
+    }
 
     while(!q.empty()){
-        var v = q.front();
+        uint32_t v = q.front();
         q.pop();
-        std::vector<var> parents = v.getParents();
-        for(var& parent : parents){
-            explored[parent]++; 
-            if(numOpArgs(parent.getOp()) == explored[parent]){
+        for(const uint32_t* p = g.parentsBegin(v); p != g.parentsEnd(v); p++){
+            var& parent = g.getNode(*p);
+            explored[*p]++; 
+            if(numOpArgs(parent.getOp()) == explored[*p]){
                 parent.setValue(_eval(parent.getOp(), parent.getChildren()));
-                q.push(parent);
+                q.push(*p);
             }
         } 
     } 
     return root.getValue();
 }
 
-std::unordered_set<var> expression::findNonConsts(const std::vector<var>& leaves){
-    std::unordered_set<var> nonconsts;
-    std::queue<var> q; 
-    for(const var& v : leaves)
-        q.push(v); 
+// A BFS up the parent edges, from the leaves.
+std::vector<bool> _find_nonconsts(const graph_index& g, const std::vector<uint32_t>& leaf_ids){
+    std::queue<uint32_t> q; 
+    std::vector<bool> visited(g.size(), false);
+    for(uint32_t id : leaf_ids){
+        if(id != graph_index::npos)
+            q.push(id); 
+    }
 
     while(!q.empty()){
-        var v = q.front();
+        uint32_t v = q.front();
         q.pop();
         
         // We should not traverse this if it has already been visited.
-        if(nonconsts.find(v) != nonconsts.end())
+        if(visited[v])
             continue;
         
-        nonconsts.insert(v);
-        std::vector<var> parents = v.getParents();
-        for(const var& parent : parents){
-            q.push(parent);
+        visited[v] = true;
+        for(const uint32_t* p = g.parentsBegin(v); p != g.parentsEnd(v); p++){
+            q.push(*p);
         }
     }
+    return visited;
+}
+
+std::unordered_set<var> expression::findNonConsts(const std::vector<var>& leaves){
+    graph_index g(root);
+    std::unordered_set<var> nonconsts(leaves.begin(), leaves.end());
+    std::vector<uint32_t> leaf_ids;
+    for(const var& v : leaves)
+        leaf_ids.push_back(g.find(v));
+    std::vector<bool> mask = _find_nonconsts(g, leaf_ids);
+    for(uint32_t id = 0; id < g.size(); id++){
+        if(mask[id])
+            nonconsts.insert(g.getNode(id));
+    }
     return nonconsts;
 }
 
-// When we perform a BFS to find the derivatives, we should be careful not to
+// When we find the derivatives, we should be careful not to
 // 1. override its original value.
 //     x = a + b
 //     y = a + c
 //     derivative of a is dx/da + dy/da
-// 2. explore too much of the tree that is not unnecessary.
+// 2. pass a node's derivative on before it is complete.
+//     A BFS reaches a node once per parent, and would expand it (and
+//     everything below it) every time, with a partial derivative.
+//     Instead, we walk the ids of a graph_index from the root down:
+//     they are in topological order, so by the time we get to a node,
+//     every one of its parents has been done, and we expand it once.
+// 3. explore too much of the tree that is not unnecessary.
 //     Ideally, our user would be smart and input a value directly rather than
 //     create an entire expression subtree for a value that is a constant.
 //     TODO: In the future, add a field in var that states whether it's a constant.
 
-void expression::backpropagate(std::unordered_map<var, double>& leaves){
-    std::queue<var> q;
-    std::unordered_map<var, double> derivatives;
-    q.push(root);
-    derivatives[root] = 1;
-    
-    while(!q.empty()){
-        var v = q.front();
-        q.pop();
-        std::vector<var>& children = v.getChildren();
-        std::vector<double> child_derivs = _back(v.getOp(), children, derivatives[v]);
-        for(size_t i = 0; i < children.size(); i++){
-            // Be careful to not override the derivative value!
-            derivatives[children[i]] += child_derivs[i];
-            if(children[i].getOp() != op_type::none)
-                q.push(children[i]); 
-        }
+// The reverse sweep itself. adjoints are indexed by id, so the inner
+// loop is plain array accesses: nodes and edges come from the CSR arrays
+// of the index, and no var is hashed.
+// If expand is not empty, only the nodes it flags pass their derivative
+// on to their children.
+void _backpropagate(const graph_index& g, std::vector<double>& adjoints,
+        const std::vector<bool>& expand){
+    adjoints.assign(g.size(), 0);
+    adjoints[g.getRoot()] = 1;
+    double* adj = adjoints.data();
+
+    for(uint32_t id = g.size(); id-- > 0;){
+        const uint32_t* c = g.childrenBegin(id);
+        size_t n = g.childrenEnd(id) - c;
+        if(n == 0 || adj[id] == 0 || (!expand.empty() && !expand[id]))
+            continue;
+        const var& v = g.getNode(id);
+        double lhs = g.getNode(c[0]).getValue();
+        double rhs = n < 2 ? 0 : g.getNode(c[1]).getValue();
+        _back_fused(v.getOp(), lhs, rhs, v.getValue(), adj[id], adj[c[0]], adj[c[n-1]]);
     }
-   
-    // After we have retrieved the derivatives,
-    // select the leaves and update in leaves.
+}
+
+// After we have retrieved the derivatives,
+// select the leaves and update in leaves.
+static void _store_leaves(const graph_index& g, const std::vector<double>& adjoints,
+        std::unordered_map<var, double>& leaves){
     for(auto& iter : leaves){
-        iter.second = derivatives[iter.first]; 
-    } 
+        uint32_t id = g.find(iter.first);
+        iter.second = id == graph_index::npos ? 0 : adjoints[id];
+    }
 }
 
-// Restricted BFS: same as previous, but we will have a set of nonconsts to tell us
-// where we can BFS to.
+void expression::backpropagate(std::unordered_map<var, double>& leaves){
+    graph_index g(root);
+    std::vector<double> adjoints;
+    _backpropagate(g, adjoints, std::vector<bool>());
+    _store_leaves(g, adjoints, leaves);
+}
+
+// Restricted version: same as previous, but we will have a set of nonconsts
+// to tell us which nodes are worth expanding.
 void expression::backpropagate(std::unordered_map<var, double>& leaves, 
         const std::unordered_set<var>& nonconsts){
-    std::queue<var> q;
-    std::unordered_map<var, double> derivatives;
-    q.push(root);
-    derivatives[root] = 1;
-    
-    while(!q.empty()){
-        var v = q.front();
-        q.pop();
-        if(nonconsts.find(v) == nonconsts.end())
-            continue;
-        std::vector<var>& children = v.getChildren();
-        std::vector<double> child_derivs = _back(v.getOp(), children, derivatives[v]);
-        for(size_t i = 0; i < children.size(); i++){
-            // Be careful to not override the derivative value!
-            derivatives[children[i]] += child_derivs[i];
-            if(children[i].getOp() != op_type::none)
-                q.push(children[i]); 
-        }
+    graph_index g(root);
+    std::vector<bool> expand(g.size(), false);
+    for(const var& v : nonconsts){
+        uint32_t id = g.find(v);
+        if(id != graph_index::npos)
+            expand[id] = true;
     }
-   
-    // After we have retrieved the derivatives,
-    // select the leaves and update in leaves.
-    for(auto& iter : leaves){
-        iter.second = derivatives[iter.first]; 
-    } 
+    std::vector<double> adjoints;
+    _backpropagate(g, adjoints, expand);
+    _store_leaves(g, adjoints, leaves);
 }
 
 }
@@ -1,11 +1,27 @@
 #pragma once
 
 #include "var.h"
+#include "graph.h"
+#include "kernels.h"
 #include <queue>
 #include <unordered_map>
 #include <unordered_set>
 
 namespace et{
+
+// The scalar kernels _eval(), _back_single() and _back_fused() are in kernels.h.
+// Same, reading the operands from the children of a node.
+double _eval(op_type op, const var::children_type& operands);
+// Forward kernels over columns of n operands at once.
+void _eval_batch(op_type op, const double* lhs, const double* rhs, double* out, size_t n);
+// Derivatives of the root of g w.r.t. every node, indexed by id.
+// If expand is not empty, only the nodes it flags are expanded.
+void _backpropagate(const graph_index& g, std::vector<double>& adjoints,
+        const std::vector<bool>& expand);
+// Flags, by id, the nodes of g that depend on one of the leaves
+// (npos ids are skipped): the ones gradient flows through.
+std::vector<bool> _find_nonconsts(const graph_index& g, const std::vector<uint32_t>& leaf_ids);
+
 /**
  * The expression class is a wrapper over a variable that
  * contains many children that will soon be evaluated.
@@ -36,8 +52,13 @@ public:
      * with appropriate values? Could be faster.
      */
 
-    // Recursively evaluates the tree.
-    // This may have memory issues if the stack size is significant.
+    // Evaluates the tree depth-first, from the root.
+    // Every node is evaluated once, even if it is shared.
+    // The traversal keeps its own stack, so the depth of the
+    // graph is not limited by the size of the native stack.
+    // The stack is reused by later calls on the same thread, and so
+    // does not allocate, unless the graph is deeper than a few thousand
+    // nodes: a larger stack is freed when the call returns.
     double propagate();
     
     // Uses the given leaves, possibly from findSource(),
@@ -50,7 +71,11 @@ public:
     std::unordered_set<var> findNonConsts(const std::vector<var>&);
 
     // Computes the derivative for the entire graph.
-    // Performs a top-down evaluation of the tree.
+    // Performs a top-down evaluation of the tree, in reverse
+    // topological order, so that every node is expanded once.
+    // The partials are computed from the values stored in the nodes,
+    // so the graph must have been evaluated (see propagate()) since
+    // the leaves last changed.
     void backpropagate(std::unordered_map<var, double>& leaves);
 
     // We need the unordered_set for knowing nonconst values.
@@ -0,0 +1,113 @@
+#include "graph.h"
+#include <stdexcept>
+
+namespace et{
+
+const uint32_t graph_index::npos;
+
+// Iterative post-order DFS, so that deep graphs do not overflow
+// the stack. A node is given its id once all of its children
+// have theirs, which makes the ids a topological order.
+graph_index::graph_index(const var& root) : has_parents(false){
+    child_offsets.push_back(0);
+    add(root);
+}
+
+// The roots are indexed one after the other, each of them
+// only adding the nodes that are not in the index yet.
+// Without roots, there would be no root for getRoot() to return.
+graph_index::graph_index(const std::vector<var>& roots) : has_parents(false){
+    if(roots.empty())
+        throw std::invalid_argument("A graph_index needs at least one root.");
+    child_offsets.push_back(0);
+    for(const var& root : roots){
+        if(ids.find(root) == ids.end())
+            add(root);
+    }
+}
+
+void graph_index::add(const var& root){
+    struct frame {
+        var v;
+        size_t next;
+    };
+    std::vector<frame> stack;
+    stack.push_back({root, 0});
+
+    while(!stack.empty()){
+        frame& f = stack.back();
+        var::children_type& children = f.v.getChildren();
+        if(f.next < children.size()){
+            const var& child = children[f.next++];
+            if(ids.find(child) == ids.end())
+                stack.push_back({child, 0});
+            continue;
+        }
+        for(const var& child : children)
+            child_ids.push_back(ids.find(child)->second);
+        child_offsets.push_back(child_ids.size());
+        ids.emplace(f.v, nodes.size());
+        nodes.push_back(f.v);
+        stack.pop_back();
+    }
+}
+
+size_t graph_index::size() const{ return nodes.size(); }
+
+uint32_t graph_index::getRoot() const{ return nodes.size() - 1; }
+
+var& graph_index::getNode(uint32_t id){ return nodes[id]; }
+
+const var& graph_index::getNode(uint32_t id) const{ return nodes[id]; }
+
+const std::vector<var>& graph_index::getNodes() const{ return nodes; }
+
+uint32_t graph_index::find(const var& v) const{
+    auto iter = ids.find(v);
+    return iter == ids.end() ? npos : iter->second;
+}
+
+const uint32_t* graph_index::childrenBegin(uint32_t id) const{
+    return child_ids.data() + child_offsets[id];
+}
+
+const uint32_t* graph_index::childrenEnd(uint32_t id) const{
+    return child_ids.data() + child_offsets[id+1];
+}
+
+const uint32_t* graph_index::parentsBegin(uint32_t id) const{
+    buildParents();
+    return parent_ids.data() + parent_offsets[id];
+}
+
+const uint32_t* graph_index::parentsEnd(uint32_t id) const{
+    buildParents();
+    return parent_ids.data() + parent_offsets[id+1];
+}
+
+void graph_index::buildParents() const{
+    if(has_parents)
+        return;
+    transpose_edges(child_offsets, child_ids, parent_offsets, parent_ids);
+    has_parents = true;
+}
+
+// A counting sort over the targets of the edges.
+void transpose_edges(const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& edges,
+        std::vector<uint32_t>& t_offsets, std::vector<uint32_t>& t_edges){
+    size_t n = offsets.size() - 1;
+    t_offsets.assign(n + 1, 0);
+    for(uint32_t e : edges)
+        t_offsets[e+1]++;
+    for(size_t i = 0; i < n; i++)
+        t_offsets[i+1] += t_offsets[i];
+
+    std::vector<uint32_t> cursor(t_offsets.begin(), t_offsets.end() - 1);
+    t_edges.resize(edges.size());
+    for(uint32_t id = 0; id < n; id++){
+        for(uint32_t e = offsets[id]; e < offsets[id+1]; e++)
+            t_edges[cursor[edges[e]]++] = id;
+    }
+}
+
+}
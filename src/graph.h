@@ -0,0 +1,77 @@
+#pragma once
+
+#include "var.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace et{
+
+/**
+ * A graph_index is a snapshot of the DAG reachable from a root.
+ * Nodes do not know their parents, so whenever an algorithm needs to
+ * walk the graph upwards (or simply visit every node once), it builds
+ * one of these in a single pass over the graph.
+ *
+ * - Every node gets a dense id. Ids are in topological order:
+ *   children always have smaller ids than their parents, and the
+ *   root has the largest id.
+ * - Child and parent edges are stored in compressed sparse row form:
+ *   the edges of node i are edges[offsets[i]] .. edges[offsets[i+1]-1].
+ *   An operand used twice (e.g. x*x) is recorded as two edges.
+ * - The parent edges are only materialized the first time they are
+ *   asked for.
+ *
+ * The index holds a reference to every node, so the graph
+ * cannot be destroyed while it is in use.
+ */
+class graph_index {
+public:
+    static const uint32_t npos = UINT32_MAX;
+
+    explicit graph_index(const var& root);
+    // The union of the graphs under several roots. Ids are still in
+    // topological order, and getRoot() is the last of the roots that
+    // was not already under another one.
+    // Throws std::invalid_argument if there are no roots.
+    explicit graph_index(const std::vector<var>& roots);
+
+    size_t size() const;
+    uint32_t getRoot() const;
+
+    // Access the nodes by id.
+    var& getNode(uint32_t);
+    const var& getNode(uint32_t) const;
+    const std::vector<var>& getNodes() const;
+
+    // Finds the id of a node, or npos if it is not in the graph.
+    uint32_t find(const var&) const;
+
+    // Edges of a node, as ranges of ids.
+    const uint32_t* childrenBegin(uint32_t) const;
+    const uint32_t* childrenEnd(uint32_t) const;
+    const uint32_t* parentsBegin(uint32_t) const;
+    const uint32_t* parentsEnd(uint32_t) const;
+
+private:
+    void add(const var& root);
+    void buildParents() const;
+
+    std::vector<var> nodes;
+    std::unordered_map<var, uint32_t> ids;
+
+    std::vector<uint32_t> child_offsets;
+    std::vector<uint32_t> child_ids;
+
+    mutable bool has_parents;
+    mutable std::vector<uint32_t> parent_offsets;
+    mutable std::vector<uint32_t> parent_ids;
+};
+
+// Transposes edges in compressed sparse row form, e.g. child edges into
+// parent edges: the edges of node i are edges[offsets[i]] .. edges[offsets[i+1]-1].
+// Nodes are visited in id order, so the edges into each node come out sorted.
+void transpose_edges(const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& edges,
+        std::vector<uint32_t>& t_offsets, std::vector<uint32_t>& t_edges);
+
+}
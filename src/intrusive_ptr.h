@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace et{
+
+/**
+ * The reference count embedded in every node.
+ *
+ * By default it is atomic, so that graphs may be shared between threads
+ * exactly as they could with std::shared_ptr. Graphs that never leave the
+ * thread that built them can define ET_SINGLE_THREADED to turn it into a
+ * plain integer, which removes the atomic increments/decrements from every
+ * var copy. The macro must be defined the same way in every translation unit.
+ */
+class refcount {
+public:
+    refcount() : count(0){}
+
+    // A copied node is a new node, with nobody referencing it yet.
+    refcount(const refcount&) : count(0){}
+    refcount& operator=(const refcount&){ return *this; }
+
+#ifdef ET_SINGLE_THREADED
+    void increment(){ count++; }
+    // Returns whether the last reference is gone.
+    bool decrement(){ return --count == 0; }
+    long get() const{ return count; }
+private:
+    long count;
+#else
+    void increment(){ count.fetch_add(1, std::memory_order_relaxed); }
+    // Returns whether the last reference is gone.
+    bool decrement(){ return count.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+    long get() const{ return count.load(std::memory_order_relaxed); }
+private:
+    std::atomic<long> count;
+#endif
+};
+
+/**
+ * A smart pointer to a T that keeps its count in the pointee (T::refs),
+ * so that there is no separate control block to allocate. When the last
+ * reference goes away it calls T::release(), which is in charge of
+ * destroying and freeing the object.
+ */
+template <typename T>
+class intrusive_ptr {
+public:
+    intrusive_ptr() : ptr(nullptr){}
+
+    explicit intrusive_ptr(T* p) : ptr(p){
+        if(ptr)
+            ptr->refs.increment();
+    }
+
+    intrusive_ptr(const intrusive_ptr& other) : intrusive_ptr(other.ptr){}
+
+    intrusive_ptr(intrusive_ptr&& other) noexcept : ptr(other.ptr){
+        other.ptr = nullptr;
+    }
+
+    intrusive_ptr& operator=(const intrusive_ptr& other){
+        intrusive_ptr(other).swap(*this);
+        return *this;
+    }
+
+    intrusive_ptr& operator=(intrusive_ptr&& other) noexcept{
+        intrusive_ptr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~intrusive_ptr(){
+        if(ptr && ptr->refs.decrement())
+            T::release(ptr);
+    }
+
+    void swap(intrusive_ptr& other) noexcept{ std::swap(ptr, other.ptr); }
+
+    T* get() const{ return ptr; }
+    T& operator*() const{ return *ptr; }
+    T* operator->() const{ return ptr; }
+    explicit operator bool() const{ return ptr != nullptr; }
+
+    long use_count() const{ return ptr ? ptr->refs.get() : 0; }
+
+private:
+    T* ptr;
+};
+
+}
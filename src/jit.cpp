@@ -0,0 +1,309 @@
+#include "jit.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace et{
+
+namespace{
+
+// Bumped whenever the generated code changes, so that
+// stale shared objects are not picked up from the cache.
+const char* generator_version = "et-jit-3";
+
+std::string env_or(const char* name, const std::string& fallback){
+    const char* v = std::getenv(name);
+    return v && *v ? std::string(v) : fallback;
+}
+
+// 64-bit FNV-1a.
+uint64_t fnv(uint64_t h, const void* data, size_t n){
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < n; i++){
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+uint64_t fnv(uint64_t h, const std::string& s){
+    return fnv(h, s.data(), s.size());
+}
+
+std::string hex(uint64_t h){
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+    return buf;
+}
+
+// The default cache is per user, so that no one else can
+// plant a library under a name we would load.
+std::string default_cache_dir(){
+    std::string xdg = env_or("XDG_CACHE_HOME", "");
+    if(!xdg.empty())
+        return xdg + "/et-jit";
+    std::string home = env_or("HOME", "");
+    if(!home.empty())
+        return home + "/.cache/et-jit";
+    return env_or("TMPDIR", "/tmp") + "/et-jit-" + std::to_string(geteuid());
+}
+
+// Whether path is ours alone: owned by us, and not writable by
+// anyone else. lstat, so that a symlink is refused too.
+bool is_private(const std::string& path, bool dir){
+    struct stat st;
+    if(lstat(path.c_str(), &st) != 0)
+        return false;
+    if(dir ? !S_ISDIR(st.st_mode) : !S_ISREG(st.st_mode))
+        return false;
+    return st.st_uid == geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// Creates the cache directory (and its parent, if need be) as 0700,
+// and checks that an existing one is private.
+bool make_cache_dir(const std::string& path){
+    if(mkdir(path.c_str(), 0700) != 0 && errno == ENOENT){
+        size_t slash = path.find_last_of('/');
+        if(slash != std::string::npos && slash > 0)
+            mkdir(path.substr(0, slash).c_str(), 0700);
+        mkdir(path.c_str(), 0700);
+    }
+    return is_private(path, true);
+}
+
+// Quotes a path for the shell, including any quotes inside it.
+std::string shell_quote(const std::string& s){
+    std::string q = "'";
+    for(char c : s){
+        if(c == '\'')
+            q += "'\\''";
+        else
+            q += c;
+    }
+    return q + "'";
+}
+
+uint32_t find_register(const bytecode& code, const var& v){
+    uint32_t id = code.getIndex().find(v);
+    if(id == graph_index::npos)
+        throw std::invalid_argument("The var is not part of the compiled graph.");
+    return id;
+}
+
+}
+
+/* et::jit_options funcs: */
+jit_options::jit_options() :
+    compiler(env_or("ET_JIT_CXX", env_or("CXX", "c++"))),
+    flags(env_or("ET_JIT_FLAGS", "-O2")),
+    cache_dir(env_or("ET_JIT_CACHE", default_cache_dir())){}
+
+/* et::jit_function funcs: */
+jit_function::jit_function(const var& root, const jit_options& options) :
+    code(root), key(hash(code)), cached(false),
+    native_forward(nullptr), native_backward(nullptr){
+    if(load(options))
+        registers.resize(code.numRegisters());
+    else{
+        cached = false;
+        library.clear();
+        handle.reset();
+    }
+}
+
+double jit_function::forward(){
+    if(!handle)
+        return code.forward();
+    const graph_index& g = code.getIndex();
+    for(uint32_t id : code.getLeaves())
+        registers[id] = g.getNode(id).getValue();
+    native_forward(registers.data());
+    return registers.back();
+}
+
+void jit_function::backward(){
+    if(!handle){
+        code.backward();
+        return;
+    }
+    adjoints.assign(registers.size(), 0);
+    adjoints.back() = 1;
+    native_backward(registers.data(), adjoints.data());
+}
+
+bool jit_function::isNative() const{ return handle != nullptr; }
+
+bool jit_function::isCached() const{ return cached; }
+
+uint64_t jit_function::getHash() const{ return key; }
+
+const std::string& jit_function::getLibraryPath() const{ return library; }
+
+double jit_function::getValue(const var& v) const{
+    if(!handle)
+        return code.getValue(v);
+    return registers[find_register(code, v)];
+}
+
+double jit_function::getDerivative(const var& v) const{
+    if(!handle)
+        return code.getDerivative(v);
+    uint32_t id = find_register(code, v);
+    return id < adjoints.size() ? adjoints[id] : 0;
+}
+
+// The partials are those of bytecode::backward().
+std::string jit_function::generate(const bytecode& code){
+    const std::vector<instruction>& c = code.getCode();
+    std::ostringstream out;
+    out << "// Generated by et::jit (" << generator_version << ").\n"
+        << "#include <cmath>\n\n"
+        << "// The shape this code was generated for, checked after loading.\n"
+        << "extern \"C\" const unsigned long long et_hash = " << hash(code) << "ULL;\n"
+        << "extern \"C\" const unsigned long long et_registers = " << code.numRegisters() << "ULL;\n"
+        << "extern \"C\" const unsigned long long et_leaves = " << code.getLeaves().size() << "ULL;\n\n"
+        << "extern \"C\" void et_forward(double* r){\n";
+    for(size_t i = 1; i + 1 < c.size(); i++){
+        std::string d = "r[" + std::to_string(c[i].dst) + "]";
+        std::string l = "r[" + std::to_string(c[i].lhs) + "]";
+        std::string r = "r[" + std::to_string(c[i].rhs) + "]";
+        out << "    " << d << " = ";
+        switch(c[i].op){
+            case opcode::add: out << l << " + " << r; break;
+            case opcode::sub: out << l << " - " << r; break;
+            case opcode::mul: out << l << " * " << r; break;
+            case opcode::div: out << l << " / " << r; break;
+            case opcode::exp: out << "std::exp(" << l << ")"; break;
+            case opcode::pow: out << "std::pow(" << l << ", " << r << ")"; break;
+            case opcode::halt: break;
+        }
+        out << ";\n";
+    }
+    out << "}\n\n"
+        << "extern \"C\" void et_backward(const double* r, double* a){\n";
+    for(size_t i = c.size() - 2; i > 0; i--){
+        std::string dst = std::to_string(c[i].dst);
+        std::string lhs = std::to_string(c[i].lhs);
+        std::string rhs = std::to_string(c[i].rhs);
+        std::string g = "a[" + dst + "]";
+        std::string al = "    a[" + lhs + "]", ar = "    a[" + rhs + "]";
+        std::string l = "r[" + lhs + "]", r = "r[" + rhs + "]";
+        switch(c[i].op){
+            case opcode::add:
+                out << al << " += " << g << ";\n" << ar << " += " << g << ";\n";
+                break;
+            case opcode::sub:
+                out << al << " += " << g << ";\n" << ar << " -= " << g << ";\n";
+                break;
+            case opcode::mul:
+                out << al << " += " << g << " * " << r << ";\n"
+                    << ar << " += " << g << " * " << l << ";\n";
+                break;
+            case opcode::div:
+                out << "    {\n        double q = " << g << " / " << r << ";\n"
+                    << "    " << al << " += q;\n"
+                    << "    " << ar << " -= q * r[" << dst << "];\n    }\n";
+                break;
+            case opcode::exp:
+                out << al << " += " << g << " * r[" << dst << "];\n";
+                break;
+            case opcode::pow:
+                out << al << " += " << g << " * std::pow(" << l << ", " << r << " - 1) * " << r << ";\n";
+                break;
+            case opcode::halt:
+                break;
+        }
+    }
+    out << "}\n";
+    return out.str();
+}
+
+uint64_t jit_function::hash(const bytecode& code){
+    uint64_t h = fnv(14695981039346656037ULL, generator_version);
+    uint64_t n = code.numRegisters();
+    h = fnv(h, &n, sizeof(n));
+    for(const instruction& i : code.getCode()){
+        uint32_t fields[4] = {static_cast<uint32_t>(i.op), i.dst, i.lhs, i.rhs};
+        h = fnv(h, fields, sizeof(fields));
+    }
+    return h;
+}
+
+// Finds the shared object in the cache, or builds it, then loads it.
+// Returns false if any step fails.
+bool jit_function::load(const jit_options& options){
+    if(!make_cache_dir(options.cache_dir))
+        return false;
+
+    // Objects built by another compiler or with other flags are not reused.
+    uint64_t file_key = fnv(fnv(key, options.compiler), options.flags);
+    std::string base = options.cache_dir + "/" + hex(file_key);
+    library = base + ".so";
+
+    if(access(library.c_str(), R_OK) == 0)
+        cached = true;
+    else{
+        // Build under a name of our own, and only then move it into
+        // place, so that other processes never see half a library.
+        // mkstemp makes the name unique across threads as well.
+        std::vector<char> name(base.begin(), base.end());
+        const char suffix[] = ".XXXXXX";
+        name.insert(name.end(), suffix, suffix + sizeof(suffix));
+        int fd = mkstemp(name.data());
+        if(fd < 0)
+            return false;
+        close(fd);
+        std::string tmp = name.data();
+        bool built = false;
+        {
+            std::ofstream src(tmp + ".cpp");
+            src << generate(code);
+            src.close();
+            if(src){
+                std::string cmd = options.compiler + " " + options.flags
+                    + " -shared -fPIC -o " + shell_quote(tmp + ".so")
+                    + " " + shell_quote(tmp + ".cpp") + " > /dev/null 2>&1";
+                built = std::system(cmd.c_str()) == 0
+                    && std::rename((tmp + ".so").c_str(), library.c_str()) == 0;
+            }
+        }
+        std::remove((tmp + ".cpp").c_str());
+        std::remove((tmp + ".so").c_str());
+        std::remove(tmp.c_str());
+        if(!built)
+            return false;
+    }
+
+    if(!is_private(library, false))
+        return false;
+
+    void* h = dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if(!h)
+        return false;
+    handle = std::shared_ptr<void>(h, [](void* p){ dlclose(p); });
+    native_forward = reinterpret_cast<forward_fn>(dlsym(h, "et_forward"));
+    native_backward = reinterpret_cast<backward_fn>(dlsym(h, "et_backward"));
+
+    // The file name is only a hash: a collision, or a stale or foreign
+    // file, must not get to write past the registers.
+    typedef const unsigned long long* count;
+    count h_hash = static_cast<count>(dlsym(h, "et_hash"));
+    count h_registers = static_cast<count>(dlsym(h, "et_registers"));
+    count h_leaves = static_cast<count>(dlsym(h, "et_leaves"));
+    return native_forward && native_backward && h_hash && h_registers && h_leaves
+        && *h_hash == key
+        && *h_registers == code.numRegisters()
+        && *h_leaves == code.getLeaves().size();
+}
+
+jit_function jit(const var& root, const jit_options& options){
+    return jit_function(root, options);
+}
+
+}
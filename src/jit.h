@@ -0,0 +1,106 @@
+#pragma once
+
+#include "bytecode.h"
+#include <memory>
+#include <string>
+
+namespace et{
+
+// Where and how et::jit() builds native code.
+// The defaults come from the environment:
+// - ET_JIT_CXX, then CXX, then c++ for the compiler,
+// - ET_JIT_FLAGS, or -O2, for the flags,
+// - ET_JIT_CACHE, then $XDG_CACHE_HOME/et-jit, then ~/.cache/et-jit,
+//   then $TMPDIR (or /tmp)/et-jit-<uid> for the cache.
+// The cache directory is created 0700. A directory or a library that
+// is not owned by the current user, or that others can write to, is
+// never used: the interpreter runs instead.
+struct jit_options {
+    jit_options();
+
+    std::string compiler;
+    std::string flags;
+    std::string cache_dir;
+};
+
+/**
+ * A graph compiled to native code.
+ *
+ * The graph is first compiled to et::bytecode, which is then translated
+ * to straight-line C++: one statement per instruction for the forward
+ * pass, and one or two per instruction, in reverse, for the adjoints.
+ * That source is built into a shared object with the system compiler,
+ * and loaded with dlopen.
+ *
+ * Shared objects are cached on disk, under a hash of the structure of
+ * the graph: graphs of the same shape (whatever their leaf values) only
+ * get compiled once, even across processes. The generated code also
+ * exports the hash and its number of registers and leaves, and a
+ * shared object that does not match the graph is not run.
+ *
+ * If there is no compiler, or anything else goes wrong along the way,
+ * the bytecode interpreter is used instead (see isNative()). Either way,
+ * the results are the same.
+ *
+ * ::Example::
+ *
+ * et::var x(1), y(2);
+ * et::var f = x * y + et::exp(x);
+ * et::jit_function fn = et::jit(f);
+ *
+ * fn.forward(); // returns 2 + e
+ * fn.backward();
+ * fn.getDerivative(x); // returns 2 + e
+ */
+class jit_function {
+public:
+    explicit jit_function(const var& root, const jit_options& = jit_options());
+
+    // Same as bytecode::forward() and bytecode::backward().
+    double forward();
+    void backward();
+
+    // Whether native code is running, rather than the interpreter.
+    bool isNative() const;
+    // Whether the native code came out of the cache.
+    bool isCached() const;
+
+    // The structural hash of the graph.
+    uint64_t getHash() const;
+    // The shared object, or "" if there is none.
+    const std::string& getLibraryPath() const;
+
+    double getValue(const var&) const;
+    double getDerivative(const var&) const;
+
+    // The generated source, for a given bytecode.
+    static std::string generate(const bytecode&);
+    // Hashes the shape of the graph: the instructions, and the number
+    // of registers. The values of the leaves do not take part.
+    static uint64_t hash(const bytecode&);
+
+private:
+    typedef void (*forward_fn)(double*);
+    typedef void (*backward_fn)(const double*, double*);
+
+    bool load(const jit_options&);
+
+    bytecode code;
+    uint64_t key;
+    bool cached;
+    std::string library;
+
+    // Closes the shared object once the last copy is gone.
+    std::shared_ptr<void> handle;
+    forward_fn native_forward;
+    backward_fn native_backward;
+
+    // The registers, when running natively.
+    std::vector<double> registers;
+    std::vector<double> adjoints;
+};
+
+// Compiles the graph under root to native code.
+jit_function jit(const var& root, const jit_options& = jit_options());
+
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "op.h"
+#include <cmath>
+#include <stdexcept>
+
+namespace et{
+
+// Scalar kernels for every operator, shared by all the evaluators.
+// Unary operators ignore rhs.
+//
+// They are inline so that evaluators which know the operator at compile
+// time (see static_expr.h) get the switch folded away.
+
+// Scalar kernel for the forward pass of every operator.
+inline double _eval(op_type op, double lhs, double rhs){
+    switch(op){
+        case op_type::plus:
+            return lhs + rhs;
+        case op_type::minus:
+            return lhs - rhs;
+        case op_type::multiply:
+            return lhs * rhs;
+        case op_type::divide:
+            return lhs / rhs;
+        case op_type::exponent:
+            return std::exp(lhs);
+        case op_type::polynomial:
+            return std::pow(lhs, rhs);
+        case op_type::none:
+            break;
+    };
+    throw std::invalid_argument("Cannot have a non-leaf contain none-op.");
+}
+
+// Scalar kernel for the partial derivative of an operator
+// with respect to its op_idx'th operand.
+inline double _back_single(op_type op, double lhs, double rhs, int op_idx){
+    switch(op){
+        case op_type::plus: {
+            return 1;
+        }
+        case op_type::minus: {
+            if(op_idx == 0)
+                return 1;
+            else
+                return -1;
+        }
+        case op_type::multiply: {
+            return op_idx == 0 ? rhs : lhs;
+        }
+        case op_type::divide: {
+            if(op_idx == 0)
+                return 1 / rhs;
+            else
+                return -lhs / std::pow(rhs, 2);
+        }
+        case op_type::exponent: {
+            return std::exp(lhs);
+        }
+        case op_type::polynomial: {
+            if(op_idx == 0)
+                return std::pow(lhs, rhs-1) * rhs;
+            else
+                return 0; // we don't support exponents other than e.
+        }
+        case op_type::none: {
+            break;
+        }
+    }; 
+    throw std::invalid_argument("Cannot have a non-leaf contain none-op.");
+}
+
+// Fused kernel for the backward pass of a node: adds adjoint times
+// the partial w.r.t. each operand to dlhs and drhs, all in one switch.
+// out is the value of the node from the forward pass, which spares
+// exponent its std::exp, and divide its second division.
+// Unary operators leave drhs alone, so callers may pass any adjoint
+// for it (e.g. dlhs again) as a stand-in. Binary ones work even if
+// dlhs and drhs are the same adjoint (as in x * x).
+inline void _back_fused(op_type op, double lhs, double rhs, double out,
+        double adjoint, double& dlhs, double& drhs){
+    switch(op){
+        case op_type::plus:
+            dlhs += adjoint;
+            drhs += adjoint;
+            return;
+        case op_type::minus:
+            dlhs += adjoint;
+            drhs -= adjoint;
+            return;
+        case op_type::multiply:
+            dlhs += adjoint * rhs;
+            drhs += adjoint * lhs;
+            return;
+        case op_type::divide: {
+            // d(lhs/rhs)/d(rhs) = -lhs/rhs^2 = -out/rhs
+            double q = adjoint / rhs;
+            dlhs += q;
+            drhs -= q * out;
+            return;
+        }
+        case op_type::exponent:
+            dlhs += adjoint * out;
+            return;
+        case op_type::polynomial:
+            // we don't support exponents other than e.
+            dlhs += adjoint * std::pow(lhs, rhs-1) * rhs;
+            return;
+        case op_type::none:
+            break;
+    }
+    throw std::invalid_argument("Cannot have a non-leaf contain none-op.");
+}
+
+}
@@ -0,0 +1,303 @@
+#include "memory.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace et{
+
+namespace{
+
+// Rough size of an std::unordered_map with n entries:
+// one heap node per entry (next pointer, cached hash, value)
+// plus one bucket pointer per entry.
+template <typename K, typename V>
+size_t hash_map_bytes(size_t n){
+    return n * (2 * sizeof(void*) + sizeof(size_t) + sizeof(std::pair<const K, V>));
+}
+
+#ifdef ET_SINGLE_THREADED
+
+struct counters {
+    size_t live_nodes;
+    size_t peak_nodes;
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t total_nodes;
+};
+
+counters& get_counters(){
+    static thread_local counters c = {};
+    return c;
+}
+
+}
+
+memory_counters get_memory_counters(){
+    counters& c = get_counters();
+    return memory_counters{c.live_nodes, c.peak_nodes, c.live_bytes, c.peak_bytes, c.total_nodes};
+}
+
+void reset_peak_memory(){
+    counters& c = get_counters();
+    c.peak_nodes = c.live_nodes;
+    c.peak_bytes = c.live_bytes;
+}
+
+void track_node_alloc(size_t bytes){
+    counters& c = get_counters();
+    c.total_nodes++;
+    c.live_nodes++;
+    c.live_bytes += bytes;
+    if(c.live_nodes > c.peak_nodes)
+        c.peak_nodes = c.live_nodes;
+    if(c.live_bytes > c.peak_bytes)
+        c.peak_bytes = c.live_bytes;
+}
+
+void track_node_free(size_t bytes){
+    counters& c = get_counters();
+    c.live_nodes--;
+    c.live_bytes -= bytes;
+}
+
+#else
+
+// Every thread counts into a shard of its own, so that allocating a node
+// never touches a cache line that other threads write to. Only the
+// owning thread writes to a shard; the atomics are for the readers, and
+// are only ever loaded and stored (no read-modify-write).
+//
+// A shard holds the nodes allocated minus the nodes freed by its thread
+// since it was last flushed into the global counters, and the highest
+// that difference went. It is flushed once it drifts flush_nodes away
+// from 0 either way, so the global atomics see one update per
+// flush_nodes nodes instead of several per node.
+//
+// reset_peak_memory() cannot reset the peaks of the shards itself.
+// Instead it bumps a reset epoch, and a shard whose epoch is behind has
+// a stale peak: readers ignore it, and the owner resets it the next
+// time it counts a node.
+const int64_t flush_nodes = 256;
+
+typedef std::atomic<int64_t> counter;
+
+void bump(counter& c, int64_t n){
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void raise(std::atomic<int64_t>& peak, int64_t n){
+    int64_t cur = peak.load(std::memory_order_relaxed);
+    while(n > cur && !peak.compare_exchange_weak(cur, n, std::memory_order_relaxed));
+}
+
+struct shard {
+    counter nodes;
+    counter bytes;
+    counter peak_nodes;
+    counter peak_bytes;
+    counter total_nodes;
+    // The reset epoch the peaks were last reset in.
+    counter epoch;
+};
+
+// The flushed counts, and the shards of the running threads.
+// Shards of threads that exited are flushed and handed to new threads.
+struct registry {
+    counter live_nodes;
+    counter live_bytes;
+    counter peak_nodes;
+    counter peak_bytes;
+    // Totals of the shards that were retired.
+    counter total_nodes;
+    // Bumped by every reset_peak_memory().
+    counter epoch;
+
+    std::mutex lock;
+    std::vector<shard*> active;
+    std::vector<shard*> spare;
+};
+
+registry& get_registry(){
+    // Never destroyed, as nodes may be freed during static destruction.
+    static registry* r = new registry();
+    return *r;
+}
+
+// Called by the owner of s: resets its peaks if there was a reset
+// since the last time. The epoch is published after the peaks, so
+// a reader that sees it up to date sees the reset peaks.
+void catch_up(registry& r, shard& s){
+    int64_t e = r.epoch.load(std::memory_order_acquire);
+    if(s.epoch.load(std::memory_order_relaxed) == e)
+        return;
+    s.peak_nodes.store(s.nodes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    s.peak_bytes.store(s.bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    s.epoch.store(e, std::memory_order_release);
+}
+
+// Folds the unflushed counts of s into the globals.
+void flush(registry& r, shard& s){
+    catch_up(r, s);
+    int64_t n = s.nodes.load(std::memory_order_relaxed);
+    int64_t b = s.bytes.load(std::memory_order_relaxed);
+    int64_t base_n = r.live_nodes.fetch_add(n, std::memory_order_relaxed);
+    int64_t base_b = r.live_bytes.fetch_add(b, std::memory_order_relaxed);
+    raise(r.peak_nodes, base_n + s.peak_nodes.load(std::memory_order_relaxed));
+    raise(r.peak_bytes, base_b + s.peak_bytes.load(std::memory_order_relaxed));
+    s.nodes.store(0, std::memory_order_relaxed);
+    s.bytes.store(0, std::memory_order_relaxed);
+    s.peak_nodes.store(0, std::memory_order_relaxed);
+    s.peak_bytes.store(0, std::memory_order_relaxed);
+}
+
+// Plain pointer, so that it can still be read after the thread's
+// destructors have run (it is null then, and a new shard is taken).
+thread_local shard* current = nullptr;
+
+// Retires the shard of the thread when it exits.
+struct shard_owner {
+    ~shard_owner(){
+        registry& r = get_registry();
+        std::lock_guard<std::mutex> l(r.lock);
+        flush(r, *current);
+        bump(r.total_nodes, current->total_nodes.load(std::memory_order_relaxed));
+        current->total_nodes.store(0, std::memory_order_relaxed);
+        for(size_t i = 0; i < r.active.size(); i++){
+            if(r.active[i] == current){
+                r.active[i] = r.active.back();
+                r.active.pop_back();
+                break;
+            }
+        }
+        r.spare.push_back(current);
+        current = nullptr;
+    }
+};
+
+shard& get_shard(){
+    if(current)
+        return *current;
+    registry& r = get_registry();
+    {
+        std::lock_guard<std::mutex> l(r.lock);
+        if(r.spare.empty())
+            current = new shard();
+        else{
+            current = r.spare.back();
+            r.spare.pop_back();
+        }
+        // Flushed, so there is no peak to keep.
+        current->epoch.store(r.epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        r.active.push_back(current);
+    }
+    static thread_local shard_owner owner;
+    (void)owner;
+    return *current;
+}
+
+memory_counters sum(registry& r){
+    int64_t live_n = r.live_nodes.load(std::memory_order_relaxed);
+    int64_t live_b = r.live_bytes.load(std::memory_order_relaxed);
+    int64_t peak_n = r.peak_nodes.load(std::memory_order_relaxed);
+    int64_t peak_b = r.peak_bytes.load(std::memory_order_relaxed);
+    int64_t total = r.total_nodes.load(std::memory_order_relaxed);
+    int64_t epoch = r.epoch.load(std::memory_order_relaxed);
+    int64_t n = live_n, b = live_b;
+    for(shard* s : r.active){
+        bool stale = s->epoch.load(std::memory_order_acquire) != epoch;
+        n += s->nodes.load(std::memory_order_relaxed);
+        b += s->bytes.load(std::memory_order_relaxed);
+        total += s->total_nodes.load(std::memory_order_relaxed);
+        // The peak of a stale shard predates the last reset.
+        if(stale)
+            continue;
+        if(live_n + s->peak_nodes.load(std::memory_order_relaxed) > peak_n)
+            peak_n = live_n + s->peak_nodes.load(std::memory_order_relaxed);
+        if(live_b + s->peak_bytes.load(std::memory_order_relaxed) > peak_b)
+            peak_b = live_b + s->peak_bytes.load(std::memory_order_relaxed);
+    }
+    memory_counters res;
+    res.live_nodes = n;
+    res.live_bytes = b;
+    res.peak_nodes = peak_n > n ? peak_n : n;
+    res.peak_bytes = peak_b > b ? peak_b : b;
+    res.total_nodes = total;
+    return res;
+}
+
+}
+
+memory_counters get_memory_counters(){
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> l(r.lock);
+    return sum(r);
+}
+
+void reset_peak_memory(){
+    registry& r = get_registry();
+    std::lock_guard<std::mutex> l(r.lock);
+    bump(r.epoch, 1);
+    memory_counters c = sum(r);
+    r.peak_nodes.store(c.live_nodes, std::memory_order_relaxed);
+    r.peak_bytes.store(c.live_bytes, std::memory_order_relaxed);
+}
+
+void track_node_alloc(size_t bytes){
+    shard& s = get_shard();
+    catch_up(get_registry(), s);
+    bump(s.total_nodes, 1);
+    bump(s.nodes, 1);
+    bump(s.bytes, bytes);
+    int64_t n = s.nodes.load(std::memory_order_relaxed);
+    int64_t b = s.bytes.load(std::memory_order_relaxed);
+    if(n > s.peak_nodes.load(std::memory_order_relaxed))
+        s.peak_nodes.store(n, std::memory_order_relaxed);
+    if(b > s.peak_bytes.load(std::memory_order_relaxed))
+        s.peak_bytes.store(b, std::memory_order_relaxed);
+    if(n >= flush_nodes)
+        flush(get_registry(), s);
+}
+
+void track_node_free(size_t bytes){
+    shard& s = get_shard();
+    bump(s.nodes, -1);
+    bump(s.bytes, -static_cast<int64_t>(bytes));
+    if(s.nodes.load(std::memory_order_relaxed) <= -flush_nodes)
+        flush(get_registry(), s);
+}
+
+#endif
+
+/* et::graph_memory funcs: */
+size_t graph_memory::resident() const{
+    return node_bytes + children_bytes;
+}
+
+size_t graph_memory::total() const{
+    return resident() + (index_bytes > adjoint_bytes ? index_bytes : adjoint_bytes);
+}
+
+graph_memory memory_stats(const var& root){
+    graph_index g(root);
+    graph_memory res = {};
+    res.nodes = g.size();
+    for(const var& v : g.getNodes()){
+        const var::children_type& children = v.getChildren();
+        res.edges += children.size();
+        res.node_bytes += var::getNodeSize();
+        if(children.spilled())
+            res.children_bytes += children.capacity() * sizeof(var);
+    }
+
+    // nodes + ids + child/parent offsets and edges.
+    res.index_bytes = res.nodes * sizeof(var)
+        + hash_map_bytes<var, uint32_t>(res.nodes)
+        + 2 * (res.nodes + 1 + res.edges) * sizeof(uint32_t);
+    // the index that backpropagate() builds, and one adjoint per node.
+    res.adjoint_bytes = res.index_bytes + res.nodes * sizeof(double);
+    return res;
+}
+
+}
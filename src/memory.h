@@ -0,0 +1,70 @@
+#pragma once
+
+#include "graph.h"
+#include <cstddef>
+
+namespace et{
+
+/**
+ * Counters for every et::var node allocated so far.
+ * They are meant for sizing memory limits and for catching leaks:
+ * once all the vars of a graph are gone, live_nodes should be back
+ * to where it was before the graph was built.
+ *
+ * The counters are process-wide. Each thread counts into a shard of its
+ * own, which is folded into the process-wide counts every few hundred
+ * nodes, so that threads building graphs do not contend on them.
+ * get_memory_counters() sums the shards: the live and total counts are
+ * exact once the threads are quiet. The peaks are exact for a single
+ * thread, and may miss a few hundred nodes per thread otherwise.
+ * Under ET_SINGLE_THREADED they are per-thread instead, and only
+ * count the nodes created and destroyed by the calling thread.
+ */
+struct memory_counters {
+    size_t live_nodes;
+    size_t peak_nodes;
+    size_t live_bytes;
+    size_t peak_bytes;
+    // Nodes allocated since the start of the program.
+    size_t total_nodes;
+};
+
+memory_counters get_memory_counters();
+
+// Sets the peaks back to the current live values.
+void reset_peak_memory();
+
+// Called by et::var whenever a node is allocated/released.
+void track_node_alloc(size_t bytes);
+void track_node_free(size_t bytes);
+
+/**
+ * A breakdown of the memory used by the graph reachable from a root.
+ * Nodes shared between several parents are only counted once.
+ */
+struct graph_memory {
+    size_t nodes;
+    size_t edges;
+
+    // The nodes themselves (value, op, refcount and inline children).
+    size_t node_bytes;
+    // Children that spilled out of the nodes onto the heap.
+    size_t children_bytes;
+
+    // Estimates of the transient memory the algorithms allocate:
+    // - index_bytes: the et::graph_index (ids, CSR child and parent
+    //   edges) built by expression::propagate(leaves)/findNonConsts.
+    // - adjoint_bytes: the index and the dense adjoint array (one double
+    //   per node) built by expression::backpropagate.
+    size_t index_bytes;
+    size_t adjoint_bytes;
+
+    // Bytes held by the graph while no algorithm is running.
+    size_t resident() const;
+    // Resident bytes plus the peak transient bytes.
+    size_t total() const;
+};
+
+graph_memory memory_stats(const var& root);
+
+}
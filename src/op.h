@@ -0,0 +1,70 @@
+#pragma once
+
+namespace et{
+
+// Current support for operators:
+// operator+
+// operator-
+// operator*
+// operator/
+// exp() // e^x
+// poly() // x^n
+enum class op_type {
+    plus,
+    minus,
+    multiply,
+    divide,
+    exponent,
+    polynomial,
+    none // no operators. leaf.
+};
+
+// Everything we know about an operator, independently of its operands.
+struct op_info {
+    op_type op;
+    const char* name;
+    // Number of operands.
+    int arity;
+    // Whether the operands can be swapped.
+    bool commutative;
+    // Whether gradient flows to every operand.
+    // (poly() does not propagate to its exponent.)
+    bool differentiable;
+    // Rough relative cost of evaluating the operator,
+    // for passes that need to weigh nodes against each other.
+    int cost;
+};
+
+// Indexed by op_type. This is a plain constexpr array, so lookups
+// are a single load, and can be done at compile time.
+constexpr op_info op_table[] = {
+    { op_type::plus,       "plus",       2, true,  true,  1 },
+    { op_type::minus,      "minus",      2, false, true,  1 },
+    { op_type::multiply,   "multiply",   2, true,  true,  1 },
+    { op_type::divide,     "divide",     2, false, true,  4 },
+    { op_type::exponent,   "exponent",   1, false, true,  20 },
+    { op_type::polynomial, "polynomial", 2, false, false, 40 },
+    { op_type::none,       "none",       0, false, false, 0 },
+};
+
+constexpr const op_info& getOpInfo(op_type op){
+    return op_table[static_cast<int>(op)];
+}
+
+constexpr int numOpArgs(op_type op){
+    return getOpInfo(op).arity;
+}
+
+// Make sure the table stays in the same order as op_type.
+static_assert(sizeof(op_table) / sizeof(op_info) == static_cast<int>(op_type::none) + 1,
+        "op_table must have an entry for every op_type.");
+static_assert(getOpInfo(op_type::plus).op == op_type::plus &&
+        getOpInfo(op_type::minus).op == op_type::minus &&
+        getOpInfo(op_type::multiply).op == op_type::multiply &&
+        getOpInfo(op_type::divide).op == op_type::divide &&
+        getOpInfo(op_type::exponent).op == op_type::exponent &&
+        getOpInfo(op_type::polynomial).op == op_type::polynomial &&
+        getOpInfo(op_type::none).op == op_type::none,
+        "op_table must be indexed by op_type.");
+
+}
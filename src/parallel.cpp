@@ -0,0 +1,329 @@
+#include "parallel.h"
+#include "expression.h"
+#include <deque>
+
+namespace et{
+
+/* et::thread_pool funcs: */
+thread_pool::thread_pool(size_t threads) :
+    job(nullptr), job_tasks(0), generation(0), next(0),
+    remaining(0), active(0), stopping(false){
+    // hardware_concurrency() may not know, and return 0.
+    for(size_t i = 1; i < threads; i++)
+        workers.emplace_back(&thread_pool::work, this);
+}
+
+thread_pool::~thread_pool(){
+    {
+        std::lock_guard<std::mutex> l(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(std::thread& t : workers)
+        t.join();
+}
+
+size_t thread_pool::size() const{
+    return workers.size() + 1;
+}
+
+void thread_pool::run(size_t tasks, const std::function<void(size_t)>& task){
+    if(tasks == 0)
+        return;
+    if(workers.empty() || tasks == 1){
+        for(size_t i = 0; i < tasks; i++)
+            task(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> l(lock);
+        job = &task;
+        job_tasks = tasks;
+        next.store(0, std::memory_order_relaxed);
+        remaining = tasks;
+        error = nullptr;
+        generation++;
+    }
+    wake.notify_all();
+
+    size_t finished = drain(task, tasks);
+
+    std::unique_lock<std::mutex> l(lock);
+    remaining -= finished;
+    // Workers that joined the batch may still be looking at it,
+    // so it must outlive them.
+    done.wait(l, [this]{ return remaining == 0 && active == 0; });
+    job = nullptr;
+    if(error){
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+size_t thread_pool::drain(const std::function<void(size_t)>& task, size_t tasks){
+    size_t finished = 0;
+    for(size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < tasks; finished++){
+        try{
+            task(i);
+        }
+        catch(...){
+            std::lock_guard<std::mutex> l(lock);
+            if(!error)
+                error = std::current_exception();
+        }
+    }
+    return finished;
+}
+
+void thread_pool::work(){
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> l(lock);
+    while(true){
+        wake.wait(l, [&]{ return stopping || (job && generation != seen); });
+        if(stopping)
+            return;
+        seen = generation;
+        const std::function<void(size_t)>& task = *job;
+        size_t tasks = job_tasks;
+        active++;
+        l.unlock();
+
+        size_t finished = drain(task, tasks);
+
+        l.lock();
+        remaining -= finished;
+        active--;
+        if(remaining == 0 && active == 0)
+            done.notify_all();
+    }
+}
+
+/* et::level_schedule funcs: */
+level_schedule::level_schedule(const graph_index& g) : levels(g.size(), 0){
+    // Ids are in topological order, so the children of a node
+    // already have their level when we get to it.
+    uint32_t top = 0;
+    for(uint32_t id = 0; id < g.size(); id++){
+        uint32_t level = 0;
+        for(const uint32_t* c = g.childrenBegin(id); c != g.childrenEnd(id); c++){
+            if(levels[*c] + 1 > level)
+                level = levels[*c] + 1;
+        }
+        levels[id] = level;
+        if(level > top)
+            top = level;
+    }
+
+    // Counting sort of the ids by level.
+    level_offsets.assign(top + 2, 0);
+    for(uint32_t level : levels)
+        level_offsets[level+1]++;
+    for(size_t i = 1; i < level_offsets.size(); i++)
+        level_offsets[i] += level_offsets[i-1];
+
+    std::vector<uint32_t> cursor(level_offsets.begin(), level_offsets.end() - 1);
+    level_ids.resize(g.size());
+    for(uint32_t id = 0; id < g.size(); id++)
+        level_ids[cursor[levels[id]]++] = id;
+}
+
+size_t level_schedule::numLevels() const{
+    return level_offsets.size() - 1;
+}
+
+uint32_t level_schedule::getLevel(uint32_t id) const{
+    return levels[id];
+}
+
+const uint32_t* level_schedule::levelBegin(size_t level) const{
+    return level_ids.data() + level_offsets[level];
+}
+
+const uint32_t* level_schedule::levelEnd(size_t level) const{
+    return level_ids.data() + level_offsets[level+1];
+}
+
+double propagate_levels(graph_index& g, const level_schedule& s, thread_pool& pool, size_t grain){
+    // Level 0 only holds leaves, which have nothing to evaluate.
+    for(size_t level = 1; level < s.numLevels(); level++){
+        const uint32_t* ids = s.levelBegin(level);
+        pool.parallel_for(0, s.levelEnd(level) - ids, grain, [&](size_t lo, size_t hi){
+            for(size_t i = lo; i < hi; i++){
+                var& v = g.getNode(ids[i]);
+                v.setValue(_eval(v.getOp(), v.getChildren()));
+            }
+        });
+    }
+    return g.getNode(g.getRoot()).getValue();
+}
+
+namespace{
+
+// The deque of runnable nodes of one thread.
+struct work_queue {
+    std::mutex lock;
+    std::deque<uint32_t> ids;
+};
+
+bool pop_back(work_queue& q, uint32_t& id){
+    std::lock_guard<std::mutex> l(q.lock);
+    if(q.ids.empty())
+        return false;
+    id = q.ids.back();
+    q.ids.pop_back();
+    return true;
+}
+
+bool steal(work_queue& q, uint32_t& id){
+    std::lock_guard<std::mutex> l(q.lock);
+    if(q.ids.empty())
+        return false;
+    id = q.ids.front();
+    q.ids.pop_front();
+    return true;
+}
+
+// Collects the nodes freed by running one node. The first one is run
+// next on the same thread, without going through the deque, and the
+// others are pushed for anyone to take.
+struct runnable {
+    work_queue& own;
+    bool has_next;
+    uint32_t next;
+
+    void add(uint32_t id){
+        if(!has_next){
+            next = id;
+            has_next = true;
+        }
+        else{
+            std::lock_guard<std::mutex> l(own.lock);
+            own.ids.push_back(id);
+        }
+    }
+};
+
+// Runs step(id, runnable&) on every one of the total nodes, starting
+// from seeds. step must add() every node it makes runnable.
+//
+// A single thread can run every node by itself, so it does not matter
+// how the pool hands out the workers.
+//
+// If step throws, the nodes waiting on that one will never run, so the
+// other workers are told to stop rather than wait for them, and the
+// pool rethrows the exception.
+template <typename Step>
+void run_stealing(thread_pool& pool, const std::vector<uint32_t>& seeds, size_t total, Step step){
+    size_t threads = pool.size();
+    std::vector<work_queue> queues(threads);
+    for(size_t i = 0; i < seeds.size(); i++)
+        queues[i % threads].ids.push_back(seeds[i]);
+    std::atomic<size_t> remaining(total);
+    std::atomic<bool> aborted(false);
+
+    pool.run(threads, [&](size_t w){
+        work_queue& own = queues[w];
+        uint32_t id;
+        while(remaining.load(std::memory_order_acquire) > 0
+                && !aborted.load(std::memory_order_relaxed)){
+            bool found = pop_back(own, id);
+            for(size_t k = 1; k < threads && !found; k++)
+                found = steal(queues[(w + k) % threads], id);
+            if(!found){
+                std::this_thread::yield();
+                continue;
+            }
+
+            runnable r = {own, true, id};
+            try{
+                while(r.has_next){
+                    r.has_next = false;
+                    step(r.next, r);
+                    remaining.fetch_sub(1, std::memory_order_acq_rel);
+                }
+            }
+            catch(...){
+                aborted.store(true, std::memory_order_relaxed);
+                throw;
+            }
+        }
+    });
+}
+
+}
+
+double propagate_stealing(graph_index& g, thread_pool& pool){
+    // The parents are built lazily, so not from inside the workers.
+    g.parentsBegin(0);
+
+    std::vector<std::atomic<uint32_t>> waiting(g.size());
+    std::vector<uint32_t> leaves;
+    for(uint32_t id = 0; id < g.size(); id++){
+        uint32_t n = g.childrenEnd(id) - g.childrenBegin(id);
+        waiting[id].store(n, std::memory_order_relaxed);
+        if(n == 0)
+            leaves.push_back(id);
+    }
+
+    run_stealing(pool, leaves, g.size(), [&](uint32_t id, runnable& ready){
+        var& v = g.getNode(id);
+        if(!v.getChildren().empty())
+            v.setValue(_eval(v.getOp(), v.getChildren()));
+        // An operand used twice is two edges, and counted twice.
+        for(const uint32_t* p = g.parentsBegin(id); p != g.parentsEnd(id); p++){
+            if(waiting[*p].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready.add(*p);
+        }
+    });
+    return g.getNode(g.getRoot()).getValue();
+}
+
+std::vector<double> backpropagate_stealing(const graph_index& g, thread_pool& pool){
+    g.parentsBegin(0);
+
+    std::vector<double> adjoints(g.size(), 0);
+    std::vector<std::atomic<uint32_t>> waiting(g.size());
+    // An index over several roots has other nodes without parents.
+    // They are seeded too, with an adjoint of 0, so that the nodes they
+    // share with the root are not left waiting on them.
+    std::vector<uint32_t> tops;
+    for(uint32_t id = 0; id < g.size(); id++){
+        uint32_t n = g.parentsEnd(id) - g.parentsBegin(id);
+        waiting[id].store(n, std::memory_order_relaxed);
+        if(n == 0)
+            tops.push_back(id);
+    }
+
+    uint32_t root = g.getRoot();
+    run_stealing(pool, tops, g.size(), [&](uint32_t id, runnable& ready){
+        double adjoint = id == root ? 1 : 0;
+        for(const uint32_t* p = g.parentsBegin(id); p != g.parentsEnd(id); p++){
+            // A parent using this node twice is listed twice in a row,
+            // but all of its operands are looked at the first time.
+            if(p != g.parentsBegin(id) && *p == p[-1])
+                continue;
+            const var& parent = g.getNode(*p);
+            const uint32_t* c = g.childrenBegin(*p);
+            size_t n = g.childrenEnd(*p) - c;
+            double lhs = g.getNode(c[0]).getValue();
+            double rhs = n < 2 ? 0 : g.getNode(c[1]).getValue();
+            double d[2] = {0, 0};
+            _back_fused(parent.getOp(), lhs, rhs, parent.getValue(), adjoints[*p], d[0], d[1]);
+            for(size_t k = 0; k < n; k++){
+                if(c[k] == id)
+                    adjoint += d[k];
+            }
+        }
+        adjoints[id] = adjoint;
+
+        for(const uint32_t* c = g.childrenBegin(id); c != g.childrenEnd(id); c++){
+            if(waiting[*c].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                ready.add(*c);
+        }
+    });
+    return adjoints;
+}
+
+}
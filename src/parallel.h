@@ -0,0 +1,148 @@
+#pragma once
+
+#include "graph.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace et{
+
+/**
+ * A fixed set of worker threads that run batches of tasks.
+ *
+ * run(n, task) calls task(0) .. task(n-1), spread over the workers
+ * and the calling thread, and returns once all of them are done.
+ * Everything the tasks wrote is then visible to the caller.
+ * If a task throws, the first exception is rethrown by run().
+ *
+ * Only one batch runs at a time: run() must not be called from
+ * several threads at once, nor from inside a task.
+ */
+class thread_pool {
+public:
+    // The calling thread counts as one of the threads,
+    // so thread_pool(1) runs everything inline.
+    explicit thread_pool(size_t threads = std::thread::hardware_concurrency());
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // Number of threads that take part in a batch.
+    size_t size() const;
+
+    void run(size_t tasks, const std::function<void(size_t)>& task);
+
+    // Splits [begin, end) into ranges of at least grain indices,
+    // and calls f(lo, hi) on each of them in parallel.
+    // Ranges smaller than grain are run inline.
+    template <typename F>
+    void parallel_for(size_t begin, size_t end, size_t grain, F f);
+
+private:
+    void work();
+    // Runs tasks of the current batch until there are none left,
+    // and returns how many it ran.
+    size_t drain(const std::function<void(size_t)>& task, size_t tasks);
+
+    std::vector<std::thread> workers;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // The current batch.
+    const std::function<void(size_t)>* job;
+    size_t job_tasks;
+    unsigned long generation;
+    std::atomic<size_t> next;
+    // Tasks not finished yet, and workers still inside the batch.
+    size_t remaining;
+    size_t active;
+    std::exception_ptr error;
+    bool stopping;
+};
+
+template <typename F>
+void thread_pool::parallel_for(size_t begin, size_t end, size_t grain, F f){
+    size_t n = end - begin;
+    if(grain == 0)
+        grain = 1;
+    // A few ranges per thread, so that uneven ones balance out.
+    size_t ranges = n / grain;
+    if(ranges > 4 * size())
+        ranges = 4 * size();
+    if(ranges <= 1){
+        if(n)
+            f(begin, end);
+        return;
+    }
+    run(ranges, [&](size_t r){
+        f(begin + n * r / ranges, begin + n * (r+1) / ranges);
+    });
+}
+
+// Below this many nodes, a level is evaluated on the calling thread.
+const size_t default_grain = 2048;
+
+/**
+ * The nodes of a graph_index grouped by depth: the leaves are on level 0,
+ * and every other node is one level above its deepest child.
+ *
+ * The nodes of a level only depend on nodes of lower levels, so the
+ * graph can be evaluated a level at a time, with all the nodes of a
+ * level evaluated in parallel.
+ *
+ * Levels are stored in compressed sparse row form, like the edges
+ * of the graph_index, and in increasing order of ids.
+ */
+class level_schedule {
+public:
+    explicit level_schedule(const graph_index&);
+
+    size_t numLevels() const;
+    // The level of a node.
+    uint32_t getLevel(uint32_t id) const;
+
+    // The nodes of a level, as a range of ids.
+    const uint32_t* levelBegin(size_t) const;
+    const uint32_t* levelEnd(size_t) const;
+
+private:
+    std::vector<uint32_t> levels;
+    std::vector<uint32_t> level_offsets;
+    std::vector<uint32_t> level_ids;
+};
+
+// Evaluates every non-leaf node of the graph a level at a time, using
+// the pool for the levels that have more than grain nodes.
+// Returns the value of the root.
+double propagate_levels(graph_index&, const level_schedule&, thread_pool&,
+        size_t grain = default_grain);
+
+// Dataflow versions of the above, which do not wait for a whole level
+// to finish before starting on the next one.
+//
+// Every node keeps an atomic count of the edges it is still waiting on,
+// and becomes runnable the moment the last one is done. Runnable nodes
+// go on the deque of the thread that freed them. Threads work from the
+// back of their own deque, and steal from the front of the others'
+// when they run dry.
+
+// Forward: a node waits on its children, and the leaves start out
+// runnable. Returns the value of the root.
+double propagate_stealing(graph_index&, thread_pool&);
+
+// Reverse: a node waits on its parents, and the nodes without parents
+// start out runnable. Only the root has an adjoint of 1. A node pulls
+// its adjoint from its parents, so no two threads ever write to the
+// same one. Returns the adjoints, indexed by id.
+// The graph must have been evaluated since the leaves last changed.
+std::vector<double> backpropagate_stealing(const graph_index&, thread_pool&);
+
+}
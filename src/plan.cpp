@@ -0,0 +1,185 @@
+#include "plan.h"
+#include "expression.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace et{
+
+// Nothing is evaluated here: the values are filled in by eval().
+plan::plan(const var& root) : evaluated(false), recomputed(0){
+    graph_index g(root);
+    nodes = g.getNodes();
+    ops.reserve(g.size());
+    offsets.reserve(g.size() + 1);
+    offsets.push_back(0);
+
+    // Ids are in topological order, so they double as instruction slots.
+    for(uint32_t id = 0; id < g.size(); id++){
+        const uint32_t* c = g.childrenBegin(id);
+        size_t n = g.childrenEnd(id) - c;
+        if(n > 2)
+            throw std::invalid_argument("et::compile only supports unary and binary operators.");
+        if(n == 0)
+            leaves.push_back(id);
+        ops.push_back(n == 0 ? op_type::none : g.getNode(id).getOp());
+        args.insert(args.end(), c, c + n);
+        offsets.push_back(args.size());
+    }
+    vals.assign(g.size(), 0);
+    versions.resize(leaves.size());
+}
+
+// Evaluates a single instruction.
+void plan::run(uint32_t id){
+    const uint32_t* a = &args[offsets[id]];
+    double rhs = offsets[id+1] - offsets[id] > 1 ? vals[a[1]] : 0;
+    vals[id] = _eval(ops[id], vals[a[0]], rhs);
+}
+
+double plan::eval(){
+    loadLeaves();
+    recomputed = 0;
+    for(uint32_t id = 0; id < ops.size(); id++){
+        if(ops[id] != op_type::none){
+            run(id);
+            recomputed++;
+        }
+    }
+    evaluated = true;
+    return vals.back();
+}
+
+double plan::update(){
+    if(!evaluated)
+        return eval();
+    if(parent_offsets.empty())
+        buildParents();
+
+    // Find the leaves that changed, and mark everything above them.
+    cone.clear();
+    for(size_t k = 0; k < leaves.size(); k++){
+        const var& leaf = nodes[leaves[k]];
+        if(leaf.getVersion() == versions[k])
+            continue;
+        versions[k] = leaf.getVersion();
+        vals[leaves[k]] = leaf.getValue();
+        stack.push_back(leaves[k]);
+    }
+    while(!stack.empty()){
+        uint32_t id = stack.back();
+        stack.pop_back();
+        for(uint32_t e = parent_offsets[id]; e < parent_offsets[id+1]; e++){
+            uint32_t parent = parent_ids[e];
+            if(!dirty[parent]){
+                dirty[parent] = true;
+                cone.push_back(parent);
+                stack.push_back(parent);
+            }
+        }
+    }
+
+    // Ids are a topological order.
+    std::sort(cone.begin(), cone.end());
+    for(uint32_t id : cone){
+        run(id);
+        dirty[id] = false;
+    }
+    recomputed = cone.size();
+    return vals.back();
+}
+
+void plan::store(){
+    for(size_t id = 0; id < nodes.size(); id++){
+        if(ops[id] != op_type::none)
+            nodes[id].setValue(vals[id]);
+    }
+}
+
+// The number of rows evaluated at a time by the batched eval().
+// Chunks are kept small enough that the columns of all the
+// instructions stay in cache.
+static size_t chunk_rows(size_t instructions){
+    const size_t max_rows = 256;
+    const size_t max_doubles = 1 << 18;
+    size_t rows = max_doubles / (instructions ? instructions : 1);
+    rows -= rows % 8;
+    if(rows < 8)
+        return 8;
+    return rows < max_rows ? rows : max_rows;
+}
+
+void plan::eval(const std::unordered_map<var, const double*>& columns, size_t rows, double* out){
+    std::vector<const double*> inputs(leaves.size(), nullptr);
+    size_t bound = 0;
+    for(size_t k = 0; k < leaves.size(); k++){
+        auto iter = columns.find(nodes[leaves[k]]);
+        if(iter != columns.end()){
+            inputs[k] = iter->second;
+            bound++;
+        }
+    }
+    if(bound != columns.size())
+        throw std::invalid_argument("Only the leaves of a plan can be bound to columns.");
+
+    size_t chunk = chunk_rows(nodes.size());
+    lanes.resize(nodes.size() * chunk);
+    for(size_t row = 0; row < rows; row += chunk){
+        size_t n = rows - row < chunk ? rows - row : chunk;
+        size_t k = 0;
+        for(size_t id = 0; id < nodes.size(); id++){
+            double* dst = &lanes[id * chunk];
+            if(ops[id] == op_type::none){
+                // Leaves are in increasing order of ids.
+                if(inputs[k])
+                    std::copy(inputs[k] + row, inputs[k] + row + n, dst);
+                else
+                    std::fill(dst, dst + n, nodes[id].getValue());
+                k++;
+                continue;
+            }
+            const uint32_t* a = &args[offsets[id]];
+            const double* lhs = &lanes[a[0] * chunk];
+            const double* rhs = offsets[id+1] - offsets[id] < 2 ? nullptr : &lanes[a[1] * chunk];
+            _eval_batch(ops[id], lhs, rhs, dst, n);
+        }
+        std::copy(&lanes[(nodes.size() - 1) * chunk], &lanes[(nodes.size() - 1) * chunk] + n, out + row);
+    }
+}
+
+size_t plan::numRecomputed() const{ return recomputed; }
+
+size_t plan::size() const{ return nodes.size(); }
+
+var plan::getRoot() const{ return nodes.back(); }
+
+const var& plan::getNode(uint32_t id) const{ return nodes[id]; }
+
+const std::vector<uint32_t>& plan::getLeaves() const{ return leaves; }
+
+const std::vector<op_type>& plan::getOps() const{ return ops; }
+
+const std::vector<double>& plan::getValues() const{ return vals; }
+
+const std::vector<uint32_t>& plan::getArgOffsets() const{ return offsets; }
+
+const std::vector<uint32_t>& plan::getArgs() const{ return args; }
+
+void plan::loadLeaves(){
+    for(size_t k = 0; k < leaves.size(); k++){
+        const var& leaf = nodes[leaves[k]];
+        versions[k] = leaf.getVersion();
+        vals[leaves[k]] = leaf.getValue();
+    }
+}
+
+// The operand ranges are laid out like the child edges of a graph_index.
+void plan::buildParents(){
+    transpose_edges(offsets, args, parent_offsets, parent_ids);
+    dirty.assign(nodes.size(), false);
+}
+
+plan compile(const var& root){
+    return plan(root);
+}
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "graph.h"
+#include <unordered_map>
+#include <vector>
+
+namespace et{
+
+/**
+ * A plan is an et::var graph compiled into a flat list of instructions.
+ *
+ * Compiling indexes the graph once (see et::graph_index) and lays out one
+ * instruction per node, in topological order, with the operands referring
+ * to the slots of earlier instructions. They are stored as a structure of
+ * arrays, like the entries of an et::tape, but in the plan itself: plans
+ * are not registered anywhere, and as many of them can be alive at once
+ * as memory allows. After that, evaluating the graph again
+ * is a linear scan over the instructions: no leaf search, no hashing and
+ * no allocation, however many times it is done.
+ *
+ * The plan keeps the graph alive, but the graph must not change shape
+ * while the plan is in use. The values of the leaves may change freely.
+ * The values it computes stay in the plan: the nodes of the graph are
+ * only written to by store(), so that eval() does not chase a pointer
+ * to every node on every call.
+ *
+ * When only a few leaves change between evaluations, update() only
+ * recomputes the nodes that depend on them. Leaves are found to be dirty
+ * through their version (see var::getVersion()), and dirtiness is pushed
+ * up to their ancestors through a parent index built on first use.
+ *
+ * ::Example::
+ *
+ * et::var x(1), y(2);
+ * et::var f = x * y + et::exp(x);
+ * et::plan p = et::compile(f);
+ *
+ * for(double v : inputs){
+ *     x.setValue(v);
+ *     p.eval();
+ * }
+ * p.store(); // f.getValue() now agrees with the last p.eval()
+ */
+class plan {
+public:
+    explicit plan(const var& root);
+
+    // Reads the current values of the leaves, re-evaluates every
+    // instruction, and returns the value of the root.
+    // Unlike et::eval, the nodes of the graph are left as they are.
+    double eval();
+
+    // Incremental version of eval(): only the cone of influence of the
+    // leaves whose value was set since the last eval()/update() is
+    // recomputed. The very first call falls back to eval().
+    double update();
+
+    // Number of instructions run by the last eval()/update().
+    size_t numRecomputed() const;
+
+    // Writes the values of the last eval()/update() back to the
+    // non-leaf nodes of the graph, so that getValue() agrees with
+    // the plan, e.g. before et::back().
+    void store();
+
+    // Evaluates the plan for rows inputs at once, and writes the values
+    // of the root to out. Every leaf in columns reads its values from the
+    // array it is mapped to, and the other leaves keep their current value
+    // for every row. The graph itself is not written to.
+    //
+    // Rows are processed in chunks, with every instruction run over a whole
+    // chunk before the next one, so it is dispatched once per chunk rather
+    // than once per row, in a loop that can be vectorized.
+    void eval(const std::unordered_map<var, const double*>& columns, size_t rows, double* out);
+
+    // Number of instructions (one per node).
+    size_t size() const;
+    var getRoot() const;
+
+    // The node compiled to instruction i.
+    const var& getNode(uint32_t) const;
+
+    // Ids of the instructions that read a leaf, in increasing order.
+    const std::vector<uint32_t>& getLeaves() const;
+
+    // The instructions themselves, laid out as in et::tape: the
+    // operands of instruction i are args[offsets[i]] .. args[offsets[i+1]-1].
+    // The values are those of the last eval()/update().
+    const std::vector<op_type>& getOps() const;
+    const std::vector<double>& getValues() const;
+    const std::vector<uint32_t>& getArgOffsets() const;
+    const std::vector<uint32_t>& getArgs() const;
+
+private:
+    void run(uint32_t id);
+    void loadLeaves();
+    void buildParents();
+
+    std::vector<var> nodes;
+    std::vector<uint32_t> leaves;
+
+    std::vector<op_type> ops;
+    std::vector<double> vals;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> args;
+
+    // The version of every leaf when it was last loaded.
+    std::vector<unsigned> versions;
+    bool evaluated;
+    size_t recomputed;
+
+    // For update(): parent edges in CSR form, and scratch space
+    // that is reused from one call to the next.
+    std::vector<uint32_t> parent_offsets;
+    std::vector<uint32_t> parent_ids;
+    std::vector<bool> dirty;
+    std::vector<uint32_t> stack;
+    std::vector<uint32_t> cone;
+
+    // For batched eval(): one column per instruction.
+    std::vector<double> lanes;
+};
+
+// Compiles the graph under root into an et::plan.
+plan compile(const var& root);
+
+}
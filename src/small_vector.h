@@ -0,0 +1,144 @@
+#pragma once
+
+#include "arena.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace et{
+
+/**
+ * A vector that keeps up to N elements inline, and only spills to
+ * the heap once it grows past that. Every operator we support has
+ * at most 2 operands, so a node's children never touch the heap,
+ * while n-ary operators can still be added later.
+ *
+ * Spilled buffers come from the node pool, like the nodes themselves.
+ *
+ * Only the part of the std::vector interface we need is provided.
+ */
+template <typename T, size_t N>
+class small_vector {
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    small_vector() : ptr(inline_data()), len(0), cap(N){}
+
+    small_vector(const small_vector& other) : small_vector(){
+        reserve(other.len);
+        for(const T& v : other)
+            push_back(v);
+    }
+
+    small_vector(small_vector&& other) : small_vector(){
+        if(other.ptr != other.inline_data()){
+            // Steal the spilled buffer.
+            ptr = other.ptr;
+            len = other.len;
+            cap = other.cap;
+            other.ptr = other.inline_data();
+            other.len = 0;
+            other.cap = N;
+        }
+        else{
+            for(T& v : other)
+                push_back(std::move(v));
+            other.clear();
+        }
+    }
+
+    small_vector& operator=(small_vector other){
+        clear();
+        reserve(other.len);
+        for(T& v : other)
+            push_back(std::move(v));
+        return *this;
+    }
+
+    ~small_vector(){
+        clear();
+        if(ptr != inline_data())
+            pool_deallocate(ptr, cap * sizeof(T));
+    }
+
+    // Copies out into a regular std::vector.
+    operator std::vector<T>() const{ return std::vector<T>(begin(), end()); }
+
+    void push_back(const T& v){ emplace_back(v); }
+    void push_back(T&& v){ emplace_back(std::move(v)); }
+
+    // args may refer to an element (e.g. v.emplace_back(v[0])), so when
+    // growing, the new element is built before the old ones are moved.
+    template <typename... Args>
+    void emplace_back(Args&&... args){
+        if(len < cap){
+            new (ptr + len) T(std::forward<Args>(args)...);
+            len++;
+            return;
+        }
+        size_t n = 2 * cap;
+        T* spill = static_cast<T*>(pool_allocate(n * sizeof(T)));
+        try{
+            new (spill + len) T(std::forward<Args>(args)...);
+        }
+        catch(...){
+            pool_deallocate(spill, n * sizeof(T));
+            throw;
+        }
+        relocate(spill, n);
+        len++;
+    }
+
+    void reserve(size_t n){
+        if(n <= cap)
+            return;
+        relocate(static_cast<T*>(pool_allocate(n * sizeof(T))), n);
+    }
+
+    void clear(){
+        for(size_t i = 0; i < len; i++)
+            ptr[i].~T();
+        len = 0;
+    }
+
+    size_t size() const{ return len; }
+    size_t capacity() const{ return cap; }
+    bool empty() const{ return len == 0; }
+    // Whether the elements have spilled onto the heap.
+    bool spilled() const{ return ptr != inline_data(); }
+
+    T& operator[](size_t i){ return ptr[i]; }
+    const T& operator[](size_t i) const{ return ptr[i]; }
+
+    iterator begin(){ return ptr; }
+    iterator end(){ return ptr + len; }
+    const_iterator begin() const{ return ptr; }
+    const_iterator end() const{ return ptr + len; }
+
+private:
+    // Moves the elements into spill, of capacity n, and frees the old buffer.
+    void relocate(T* spill, size_t n){
+        for(size_t i = 0; i < len; i++){
+            new (spill + i) T(std::move(ptr[i]));
+            ptr[i].~T();
+        }
+        if(ptr != inline_data())
+            pool_deallocate(ptr, cap * sizeof(T));
+        ptr = spill;
+        cap = n;
+    }
+
+    T* inline_data(){ return reinterpret_cast<T*>(storage); }
+    const T* inline_data() const{ return reinterpret_cast<const T*>(storage); }
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[N];
+    T* ptr;
+    size_t len;
+    size_t cap;
+};
+
+}
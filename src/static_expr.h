@@ -0,0 +1,137 @@
+#pragma once
+
+#include "kernels.h"
+#include <cstddef>
+
+namespace et{
+
+/**
+ * Expression templates, for formulas that are fixed at compile time.
+ *
+ * Instead of building an et::var graph at runtime, the operators below
+ * build a type that spells out the formula: `x * y + 1` is a
+ * static_expr<plus, static_expr<multiply, static_var<0>, static_var<1>>,
+ * static_const>. The whole expression lives on the stack, and evaluating
+ * it or differentiating it is inlined code, with no allocation, no
+ * refcounting and no dispatch on the operator. The operators have the
+ * same semantics as everywhere else, since they are computed with the
+ * same _eval() and _back_fused() kernels, with the operator known at
+ * compile time.
+ *
+ * Inputs are numbered: static_var<I> reads x[I] from the array of
+ * inputs given to eval() or back().
+ *
+ * ::Example::
+ *
+ * et::static_var<0> x;
+ * et::static_var<1> y;
+ * auto f = et::poly(et::exp(3*x + 1), 2.5)/10 + x*y;
+ *
+ * double in[2] = {0.5, 2};
+ * double grad[2] = {0, 0};
+ * et::eval(f, in);       // the value of f
+ * et::back(f, in, grad); // the value again, and df/dx, df/dy in grad
+ */
+
+// Every static expression derives from static_base, so that the
+// operators below only apply to static expressions.
+template <typename E>
+struct static_base {
+    const E& self() const{ return static_cast<const E&>(*this); }
+};
+
+// The I'th input.
+template <size_t I>
+struct static_var : static_base<static_var<I>> {
+    static_var() : val(0){}
+
+    double forward(const double* x) const{ return val = x[I]; }
+    void backward(double adjoint, double* grad) const{ grad[I] += adjoint; }
+
+    // The value as of the last forward().
+    mutable double val;
+};
+
+// A constant. No gradient flows into it.
+struct static_const : static_base<static_const> {
+    explicit static_const(double v) : val(v){}
+
+    double forward(const double*) const{ return val; }
+    void backward(double, double*) const{}
+
+    double val;
+};
+
+// An operator applied to one or two subexpressions.
+// Unary operators get a static_const(0) as their rhs.
+//
+// forward() leaves the value of every node in it, so that
+// backward() does not need to evaluate anything twice.
+template <op_type Op, typename L, typename R>
+struct static_expr : static_base<static_expr<Op, L, R>> {
+    static_expr(const L& l, const R& r) : lhs(l), rhs(r), val(0){}
+
+    double forward(const double* x) const{
+        double l = lhs.forward(x);
+        double r = numOpArgs(Op) < 2 ? 0 : rhs.forward(x);
+        return val = _eval(Op, l, r);
+    }
+
+    void backward(double adjoint, double* grad) const{
+        double dl = 0, dr = 0;
+        _back_fused(Op, lhs.val, rhs.val, val, adjoint, dl, dr);
+        lhs.backward(dl, grad);
+        if(numOpArgs(Op) == 2 && getOpInfo(Op).differentiable)
+            rhs.backward(dr, grad);
+    }
+
+    L lhs;
+    R rhs;
+    mutable double val;
+};
+
+// Evaluates e with the inputs x, and returns its value.
+template <typename E>
+inline double eval(const static_base<E>& e, const double* x){
+    return e.self().forward(x);
+}
+
+// Evaluates e with the inputs x, adds the derivative of e w.r.t.
+// input I to grad[I] for every input, and returns the value of e.
+template <typename E>
+inline double back(const static_base<E>& e, const double* x, double* grad){
+    double v = e.self().forward(x);
+    e.self().backward(1, grad);
+    return v;
+}
+
+// Binary operators, between two static expressions,
+// or a static expression and a constant.
+#define ET_STATIC_BINARY(name, op)                                              \
+template <typename L, typename R>                                               \
+inline static_expr<op, L, R> name(const static_base<L>& l, const static_base<R>& r){ \
+    return static_expr<op, L, R>(l.self(), r.self());                           \
+}                                                                               \
+template <typename L>                                                           \
+inline static_expr<op, L, static_const> name(const static_base<L>& l, double r){ \
+    return static_expr<op, L, static_const>(l.self(), static_const(r));         \
+}                                                                               \
+template <typename R>                                                           \
+inline static_expr<op, static_const, R> name(double l, const static_base<R>& r){ \
+    return static_expr<op, static_const, R>(static_const(l), r.self());         \
+}
+
+ET_STATIC_BINARY(operator+, op_type::plus)
+ET_STATIC_BINARY(operator-, op_type::minus)
+ET_STATIC_BINARY(operator*, op_type::multiply)
+ET_STATIC_BINARY(operator/, op_type::divide)
+ET_STATIC_BINARY(poly, op_type::polynomial)
+
+#undef ET_STATIC_BINARY
+
+template <typename E>
+inline static_expr<op_type::exponent, E, static_const> exp(const static_base<E>& e){
+    return static_expr<op_type::exponent, E, static_const>(e.self(), static_const(0));
+}
+
+}
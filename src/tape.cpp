@@ -0,0 +1,275 @@
+#include "tape.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+
+namespace et{
+
+// The registry of live tapes. Lookups from tvars are a single
+// atomic load; only creating and destroying a tape takes the lock.
+//
+// A tape id is a slot of the registry in its low 16 bits, and the
+// generation of that slot in its high 16 bits. The generation is bumped
+// every time the slot is freed, so a tvar that outlives its tape does
+// not resolve to the next tape put in the same slot. Freed slots are
+// reused oldest first, so an id only comes back after 2^16 generations
+// of its slot.
+static const uint32_t slot_bits = 16;
+static const uint32_t slot_mask = tape::max_tapes - 1;
+// Generations skip 0xFFFF, so that no id is ever no_id.
+static const uint32_t max_generation = 0xFFFF;
+
+static std::atomic<tape*> registry[tape::max_tapes];
+static uint32_t generations[tape::max_tapes];
+static std::mutex registry_lock;
+static std::deque<uint32_t> free_slots;
+static uint32_t next_slot = 0;
+
+static uint32_t register_tape(tape* t){
+    std::lock_guard<std::mutex> guard(registry_lock);
+    uint32_t slot;
+    if(!free_slots.empty()){
+        slot = free_slots.front();
+        free_slots.pop_front();
+    }
+    else if(next_slot < tape::max_tapes)
+        slot = next_slot++;
+    else
+        throw std::length_error("Too many et::tapes alive at once.");
+    registry[slot].store(t, std::memory_order_release);
+    return generations[slot] << slot_bits | slot;
+}
+
+static void unregister_tape(uint32_t id){
+    if(id == tape::no_id)
+        return; // moved-from
+    uint32_t slot = id & slot_mask;
+    std::lock_guard<std::mutex> guard(registry_lock);
+    registry[slot].store(nullptr, std::memory_order_release);
+    generations[slot] = (generations[slot] + 1) % max_generation;
+    free_slots.push_back(slot);
+}
+
+/* et::tvar funcs: */
+tvar::tvar(uint32_t _tape_id, uint32_t _index) : tape_id(_tape_id), index(_index){}
+
+tape& tvar::getTape() const{ return tape::get(tape_id); }
+
+uint32_t tvar::getTapeId() const{ return tape_id; }
+
+uint32_t tvar::getIndex() const{ return index; }
+
+double tvar::getValue() const{
+    tape& t = getTape();
+    return t.getValue(t.checkOwned(*this));
+}
+
+void tvar::setValue(double _val){
+    tape& t = getTape();
+    t.setValue(t.checkOwned(*this), _val);
+}
+
+op_type tvar::getOp() const{
+    tape& t = getTape();
+    return t.getOp(t.checkOwned(*this));
+}
+
+bool tvar::operator==(const tvar& rhs) const{
+    return tape_id == rhs.tape_id && index == rhs.index;
+}
+
+bool tvar::operator!=(const tvar& rhs) const{ return !(*this == rhs); }
+
+/* et::tape funcs: */
+const uint32_t tape::max_tapes;
+const uint32_t tape::no_id;
+
+tape::tape() : id(register_tape(this)), offsets(1, 0){}
+
+tape::~tape(){ unregister_tape(id); }
+
+// A moved-from tape is left without an id: it may only be
+// destroyed or assigned to.
+tape::tape(tape&& other)
+: id(other.id), 
+    ops(std::move(other.ops)), 
+    vals(std::move(other.vals)),
+    offsets(std::move(other.offsets)),
+    args(std::move(other.args)),
+    adjoints(std::move(other.adjoints)){
+    other.id = no_id;
+    if(id != no_id)
+        registry[id & slot_mask].store(this, std::memory_order_release);
+}
+
+tape& tape::operator=(tape&& other){
+    if(this == &other)
+        return *this;
+    unregister_tape(id);
+    id = other.id;
+    ops = std::move(other.ops);
+    vals = std::move(other.vals);
+    offsets = std::move(other.offsets);
+    args = std::move(other.args);
+    adjoints = std::move(other.adjoints);
+    other.id = no_id;
+    if(id != no_id)
+        registry[id & slot_mask].store(this, std::memory_order_release);
+    return *this;
+}
+
+tape& tape::get(uint32_t id){
+    tape* t = id == no_id ? nullptr : registry[id & slot_mask].load(std::memory_order_acquire);
+    // A tape in the same slot, but of another generation.
+    if(t == nullptr || t->id != id)
+        throw std::invalid_argument("The tvar's tape no longer exists.");
+    return *t;
+}
+
+uint32_t tape::getId() const{ return id; }
+
+tvar tape::variable(double _val){
+    return tvar(id, append(op_type::none, _val, nullptr, 0));
+}
+
+// The value is computed before anything is recorded, so an operator
+// that throws leaves the tape as it was.
+tvar tape::push(op_type op, tvar v){
+    checkArity(op, 1);
+    uint32_t a = checkOwned(v);
+    double val = _eval(op, vals[a], 0);
+    return tvar(id, append(op, val, &a, 1));
+}
+
+tvar tape::push(op_type op, tvar lhs, tvar rhs){
+    checkArity(op, 2);
+    uint32_t a[2] = {checkOwned(lhs), checkOwned(rhs)};
+    double val = _eval(op, vals[a[0]], vals[a[1]]);
+    return tvar(id, append(op, val, a, 2));
+}
+
+/* getters and setters */
+op_type tape::getOp(uint32_t i) const{ return ops[i]; }
+
+double tape::getValue(uint32_t i) const{ return vals[i]; }
+
+void tape::setValue(uint32_t i, double _val){ vals[i] = _val; }
+
+uint32_t tape::numArgs(uint32_t i) const{ return offsets[i+1] - offsets[i]; }
+
+const uint32_t* tape::getArgs(uint32_t i) const{ return args.data() + offsets[i]; }
+
+const std::vector<op_type>& tape::getOps() const{ return ops; }
+
+const std::vector<double>& tape::getValues() const{ return vals; }
+
+const std::vector<uint32_t>& tape::getArgOffsets() const{ return offsets; }
+
+const std::vector<uint32_t>& tape::getArgs() const{ return args; }
+
+size_t tape::size() const{ return ops.size(); }
+
+void tape::reserve(size_t n){
+    ops.reserve(n);
+    vals.reserve(n);
+    offsets.reserve(n + 1);
+    args.reserve(2 * n);
+}
+
+void tape::clear(){
+    ops.clear();
+    vals.clear();
+    offsets.assign(1, 0);
+    args.clear();
+    adjoints.clear();
+}
+
+double tape::forward(){
+    const op_type* op = ops.data();
+    const uint32_t* off = offsets.data();
+    const uint32_t* arg = args.data();
+    double* val = vals.data();
+    size_t n = ops.size();
+
+    for(size_t i = 0; i < n; i++){
+        if(op[i] == op_type::none)
+            continue;
+        const uint32_t* a = arg + off[i];
+        double rhs = off[i+1] - off[i] > 1 ? val[a[1]] : 0;
+        val[i] = _eval(op[i], val[a[0]], rhs);
+    }
+    return n == 0 ? 0 : val[n-1];
+}
+
+// Every entry only refers to entries before it, so by the time
+// we reach an entry walking backwards, all of its parents have
+// already added their contributions to its adjoint.
+void tape::backward(tvar root){
+    uint32_t end = checkOwned(root) + 1;
+    adjoints.assign(ops.size(), 0);
+    adjoints[end - 1] = 1;
+
+    const op_type* op = ops.data();
+    const uint32_t* off = offsets.data();
+    const uint32_t* arg = args.data();
+    const double* val = vals.data();
+    double* adj = adjoints.data();
+
+    for(uint32_t i = end; i-- > 0;){
+        if(op[i] == op_type::none || adj[i] == 0)
+            continue;
+        const uint32_t* a = arg + off[i];
+        bool binary = off[i+1] - off[i] > 1;
+        double lhs = val[a[0]];
+        double rhs = binary ? val[a[1]] : 0;
+        _back_fused(op[i], lhs, rhs, val[i], adj[i], adj[a[0]], adj[binary ? a[1] : a[0]]);
+    }
+}
+
+double tape::getDerivative(tvar v) const{
+    uint32_t i = checkOwned(v);
+    return i < adjoints.size() ? adjoints[i] : 0;
+}
+
+const std::vector<double>& tape::getDerivatives() const{ return adjoints; }
+
+// Either every array gets the new entry, or none of them do:
+// operands left behind in args would shift the operand ranges
+// of every entry recorded after them.
+uint32_t tape::append(op_type op, double val, const uint32_t* a, uint32_t n){
+    if(ops.size() >= UINT32_MAX)
+        throw std::length_error("et::tape cannot hold more than 2^32-1 entries.");
+    size_t old_size = ops.size(), old_args = args.size();
+    try{
+        args.insert(args.end(), a, a + n);
+        ops.push_back(op);
+        vals.push_back(val);
+        offsets.push_back(args.size());
+    }
+    catch(...){
+        args.resize(old_args);
+        ops.resize(old_size);
+        vals.resize(old_size);
+        offsets.resize(old_size + 1);
+        throw;
+    }
+    return ops.size() - 1;
+}
+
+void tape::checkArity(op_type op, int n){
+    if(numOpArgs(op) != n)
+        throw std::invalid_argument("The operator does not take that many operands.");
+}
+
+// Catches tvars of other tapes, and tvars past the end of this one
+// (e.g. kept across clear()).
+uint32_t tape::checkOwned(tvar v) const{
+    if(v.getTapeId() != id)
+        throw std::invalid_argument("Cannot mix tvars from different tapes.");
+    if(v.getIndex() >= ops.size())
+        throw std::out_of_range("The tvar points past the end of its tape.");
+    return v.getIndex();
+}
+
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "expression.h"
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace et{
+// forward declare class tape
+class tape;
+
+/**
+ * A tvar is a handle to a value recorded on an et::tape.
+ * Unlike et::var, it does not own anything: it is the 32-bit id
+ * of the tape it lives on and the 32-bit index of the record that
+ * produced it. It is trivially copyable and 8 bytes wide, so copying
+ * one never touches a refcount.
+ *
+ * A tvar must not be used after its tape is destroyed: it then throws.
+ *
+ * ::Example::
+ *
+ * et::tape t;
+ * et::tvar x = t.variable(2), y = t.variable(3);
+ * et::tvar z = x * y + et::exp(x);
+ *
+ * t.forward(); // returns 6 + e^2
+ * t.backward(z);
+ * t.getDerivative(x); // returns 3 + e^2
+ */
+class tvar {
+public:
+    tvar(uint32_t, uint32_t);
+
+    tape& getTape() const;
+    uint32_t getTapeId() const;
+    uint32_t getIndex() const;
+
+    // Access/Modify the value held in the record.
+    double getValue() const;
+    void setValue(double);
+    op_type getOp() const;
+
+    bool operator==(const tvar& rhs) const;
+    bool operator!=(const tvar& rhs) const;
+private:
+    uint32_t tape_id;
+    uint32_t index;
+};
+
+static_assert(std::is_trivially_copyable<tvar>::value, "tvar must stay a plain handle.");
+static_assert(sizeof(tvar) == 8, "tvar must stay a plain handle.");
+
+/**
+ * The tape is a flat Wengert list: every operator applied to a tvar
+ * appends one entry to the tape instead of allocating a node.
+ * Because operands are always recorded before the operators that
+ * use them, the order of the tape is already a topological order:
+ * - forward() is a single linear scan from the first entry.
+ * - backward() is a single linear scan back from the root.
+ *
+ * There are no parent links, no queues and no hash maps involved.
+ *
+ * The entries are stored as a structure of arrays: op codes, values
+ * and operand index ranges (offsets into one flat operand array) each
+ * live in their own contiguous vector, and the adjoints in yet another.
+ * Each sweep only streams through the arrays it actually reads.
+ *
+ * Every live tape is registered under a 32-bit id, which is what
+ * tvars use to find it. At most max_tapes tapes may be alive at once.
+ * Ids carry a generation count, so a tvar of a destroyed tape throws
+ * rather than reaching a newer tape that was given the same slot.
+ */
+class tape {
+public:
+    static const uint32_t max_tapes = 1 << 16;
+    // The id of a moved-from tape.
+    static const uint32_t no_id = UINT32_MAX;
+
+    tape();
+    ~tape();
+
+    // The entries are addressed by the tvars pointing into it,
+    // so the tape cannot be copied. Moving it hands its id over,
+    // so that existing tvars follow it to its new place.
+    tape(const tape&) = delete;
+    tape& operator=(const tape&) = delete;
+    tape(tape&&);
+    tape& operator=(tape&&);
+
+    // Finds a live tape by id.
+    static tape& get(uint32_t id);
+    uint32_t getId() const;
+
+    // Records a new leaf.
+    tvar variable(double);
+
+    // Records an operator applied to previously recorded values,
+    // and computes its value eagerly. Throws std::invalid_argument
+    // if the operator takes another number of operands.
+    tvar push(op_type, tvar);
+    tvar push(op_type, tvar, tvar);
+
+    // Access/Modify a single entry.
+    op_type getOp(uint32_t) const;
+    double getValue(uint32_t) const;
+    void setValue(uint32_t, double);
+    uint32_t numArgs(uint32_t) const;
+    const uint32_t* getArgs(uint32_t) const;
+
+    // Access the arrays directly, for evaluators.
+    // The operands of entry i are args[offsets[i]] .. args[offsets[i+1]-1].
+    const std::vector<op_type>& getOps() const;
+    const std::vector<double>& getValues() const;
+    const std::vector<uint32_t>& getArgOffsets() const;
+    const std::vector<uint32_t>& getArgs() const;
+
+    size_t size() const;
+    void reserve(size_t);
+    // Drops every entry. tvars into the tape must not be used
+    // afterwards: those past the new end throw, but those that
+    // entries were recorded over again point at the new entries.
+    void clear();
+
+    // Re-evaluates every entry in order, e.g. after leaves have
+    // been changed through tvar::setValue().
+    // Returns the value of the last entry.
+    double forward();
+
+    // Computes the derivative of root w.r.t. every entry before it.
+    // The adjoints are kept until the next call to backward().
+    void backward(tvar root);
+    double getDerivative(tvar) const;
+    const std::vector<double>& getDerivatives() const;
+
+private:
+    friend class tvar;
+
+    uint32_t append(op_type, double, const uint32_t*, uint32_t);
+    static void checkArity(op_type, int);
+    uint32_t checkOwned(tvar) const;
+
+    uint32_t id;
+    std::vector<op_type> ops;
+    std::vector<double> vals;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> args;
+    std::vector<double> adjoints;
+};
+
+// Arithmetic expressions on tvars. Constants are recorded as leaves
+// on the tape of the other operand.
+
+inline tvar operator+(tvar lhs, tvar rhs){
+    return lhs.getTape().push(op_type::plus, lhs, rhs);
+}
+
+inline tvar operator+(double lhs, tvar rhs){
+    return rhs.getTape().variable(lhs) + rhs;
+}
+
+inline tvar operator+(tvar lhs, double rhs){
+    return lhs + lhs.getTape().variable(rhs);
+}
+
+inline tvar operator-(tvar lhs, tvar rhs){
+    return lhs.getTape().push(op_type::minus, lhs, rhs);
+}
+
+inline tvar operator-(double lhs, tvar rhs){
+    return rhs.getTape().variable(lhs) - rhs;
+}
+
+inline tvar operator-(tvar lhs, double rhs){
+    return lhs - lhs.getTape().variable(rhs);
+}
+
+inline tvar operator*(tvar lhs, tvar rhs){
+    return lhs.getTape().push(op_type::multiply, lhs, rhs);
+}
+
+inline tvar operator*(double lhs, tvar rhs){
+    return rhs.getTape().variable(lhs) * rhs;
+}
+
+inline tvar operator*(tvar lhs, double rhs){
+    return lhs * lhs.getTape().variable(rhs);
+}
+
+inline tvar operator/(tvar lhs, tvar rhs){
+    return lhs.getTape().push(op_type::divide, lhs, rhs);
+}
+
+inline tvar operator/(double lhs, tvar rhs){
+    return rhs.getTape().variable(lhs) / rhs;
+}
+
+inline tvar operator/(tvar lhs, double rhs){
+    return lhs / lhs.getTape().variable(rhs);
+}
+
+inline tvar exp(tvar v){
+    return v.getTape().push(op_type::exponent, v);
+}
+
+inline tvar poly(tvar v, tvar power){
+    return v.getTape().push(op_type::polynomial, v, power);
+}
+
+inline tvar poly(tvar v, double power){
+    return poly(v, v.getTape().variable(power));
+}
+
+}
@@ -1,4 +1,6 @@
 #include "utils.h"
+#include <algorithm>
+#include <stdexcept>
 
 namespace et{
 
@@ -10,22 +12,174 @@ double eval(var& root, bool iter){
         return exp.propagate();
 }
 
+double eval(var& root, thread_pool& pool, bool steal){
+    graph_index g(root);
+    if(steal)
+        return propagate_stealing(g, pool);
+    level_schedule s(g);
+    return propagate_levels(g, s, pool);
+}
+
 void back(const var& root, 
         std::unordered_map<var, double>& derivative,
         std::set<back_flags> flags){
-    expression exp(root);
+    graph_index g(root);
+    std::vector<bool> expand;
+    // One index serves both to find the nonconsts and to backpropagate.
     if(flags.find(back_flags::const_qualify) != flags.end()){
-        std::vector<var> leaves;
-        for(auto p : derivative){
-            leaves.push_back(p.first); 
-        }
-        std::unordered_set<var> s = exp.findNonConsts(leaves);
-        exp.backpropagate(derivative, s);
+        std::vector<uint32_t> leaf_ids;
+        for(auto& p : derivative)
+            leaf_ids.push_back(g.find(p.first));
+        expand = _find_nonconsts(g, leaf_ids);
+    }
+    std::vector<double> adjoints;
+    _backpropagate(g, adjoints, expand);
+    for(auto& iter : derivative){
+        uint32_t id = g.find(iter.first);
+        iter.second = id == graph_index::npos ? 0 : adjoints[id];
+    }
+}
+
+void back(const var& root, const std::vector<var>& leaves, double* gradient){
+    graph_index g(root);
+    std::vector<uint32_t> leaf_ids;
+    for(const var& leaf : leaves)
+        leaf_ids.push_back(g.find(leaf));
+    back(g, leaf_ids, gradient);
+}
+
+void back(const graph_index& g, const std::vector<uint32_t>& leaf_ids, double* gradient){
+    std::vector<double> adjoints;
+    _backpropagate(g, adjoints, std::vector<bool>());
+    for(size_t k = 0; k < leaf_ids.size(); k++)
+        gradient[k] = leaf_ids[k] == graph_index::npos ? 0 : adjoints[leaf_ids[k]];
+}
+
+void back(const var& root,
+        std::unordered_map<var, double>& derivative,
+        thread_pool& pool){
+    graph_index g(root);
+    std::vector<double> adjoints = backpropagate_stealing(g, pool);
+    for(auto& iter : derivative){
+        uint32_t id = g.find(iter.first);
+        iter.second = id == graph_index::npos ? 0 : adjoints[id];
     }
-    else{ 
-        exp.backpropagate(derivative);
+}
+
+// Fills values with the value of every node, and
+// partials with the partials of every node w.r.t. its
+// (at most 2) operands, both indexed by id.
+static void _jacobian_forward(const graph_index& g, std::vector<double>& values,
+        std::vector<double>& partials){
+    values.resize(g.size());
+    partials.assign(2 * g.size(), 0);
+    for(uint32_t id = 0; id < g.size(); id++){
+        const uint32_t* c = g.childrenBegin(id);
+        size_t n = g.childrenEnd(id) - c;
+        const var& v = g.getNode(id);
+        if(n == 0){
+            values[id] = v.getValue();
+            continue;
+        }
+        double lhs = values[c[0]];
+        double rhs = n < 2 ? 0 : values[c[1]];
+        values[id] = _eval(v.getOp(), lhs, rhs);
+        _back_fused(v.getOp(), lhs, rhs, values[id], 1, partials[2*id], partials[2*id+1]);
     }
 }
 
+std::vector<double> jacobian(const std::vector<var>& roots,
+        const std::vector<var>& leaves,
+        jacobian_mode mode){
+    const size_t W = jacobian_lanes;
+    std::vector<double> res(roots.size() * leaves.size(), 0);
+    if(res.empty())
+        return res;
+
+    for(const var& leaf : leaves){
+        if(leaf.getOp() != op_type::none)
+            throw std::invalid_argument("et::jacobian only differentiates w.r.t. leaves.");
+    }
+
+    graph_index g(roots);
+    std::vector<double> values, partials;
+    _jacobian_forward(g, values, partials);
+    const double* d = partials.data();
+
+    std::vector<uint32_t> root_ids, leaf_ids;
+    for(const var& root : roots)
+        root_ids.push_back(g.find(root));
+    for(const var& leaf : leaves)
+        leaf_ids.push_back(g.find(leaf));
+
+    if(mode == jacobian_mode::automatic)
+        mode = leaves.size() < roots.size() ? jacobian_mode::forward : jacobian_mode::reverse;
+
+    // lanes[id * W + s] is the adjoint (or tangent) of node id for seed s.
+    std::vector<double> lanes(g.size() * W);
+    double* l = lanes.data();
+
+    if(mode == jacobian_mode::reverse){
+        for(size_t first = 0; first < roots.size(); first += W){
+            size_t seeds = std::min(W, roots.size() - first);
+            std::fill(lanes.begin(), lanes.end(), 0);
+            uint32_t top = 0;
+            for(size_t s = 0; s < seeds; s++){
+                l[root_ids[first + s] * W + s] = 1;
+                top = std::max(top, root_ids[first + s]);
+            }
+            // Nothing above the highest seeded root has an adjoint.
+            for(uint32_t id = top + 1; id-- > 0;){
+                const uint32_t* c = g.childrenBegin(id);
+                size_t n = g.childrenEnd(id) - c;
+                if(n == 0)
+                    continue;
+                const double* a = l + id * W;
+                double* al = l + c[0] * W;
+                double* ar = l + c[n-1] * W;
+                for(size_t s = 0; s < W; s++)
+                    al[s] += a[s] * d[2*id];
+                // Unary operators have a 0 partial w.r.t. their rhs.
+                if(n == 2){
+                    for(size_t s = 0; s < W; s++)
+                        ar[s] += a[s] * d[2*id+1];
+                }
+            }
+            for(size_t s = 0; s < seeds; s++){
+                for(size_t j = 0; j < leaves.size(); j++){
+                    if(leaf_ids[j] != graph_index::npos)
+                        res[(first + s) * leaves.size() + j] = l[leaf_ids[j] * W + s];
+                }
+            }
+        }
+    }
+    else{
+        for(size_t first = 0; first < leaves.size(); first += W){
+            size_t seeds = std::min(W, leaves.size() - first);
+            std::fill(lanes.begin(), lanes.end(), 0);
+            for(size_t s = 0; s < seeds; s++){
+                if(leaf_ids[first + s] != graph_index::npos)
+                    l[leaf_ids[first + s] * W + s] = 1;
+            }
+            for(uint32_t id = 0; id < g.size(); id++){
+                const uint32_t* c = g.childrenBegin(id);
+                size_t n = g.childrenEnd(id) - c;
+                if(n == 0)
+                    continue;
+                double* t = l + id * W;
+                const double* tl = l + c[0] * W;
+                const double* tr = l + c[n-1] * W;
+                double dl = d[2*id], dr = d[2*id+1];
+                for(size_t s = 0; s < W; s++)
+                    t[s] = dl * tl[s] + dr * tr[s];
+            }
+            for(size_t i = 0; i < roots.size(); i++){
+                for(size_t s = 0; s < seeds; s++)
+                    res[i * leaves.size() + first + s] = l[root_ids[i] * W + s];
+            }
+        }
+    }
+    return res;
+}
 
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "expression.h"
+#include "parallel.h"
+#include "plan.h"
 #include <set>
 
 namespace et{
@@ -8,7 +10,8 @@ namespace et{
 // The utils file is a list of functions that
 // could be commonly used by the user.
 //
-// So far, we support eval(), and back().
+// So far, we support eval(), back() and compile()
+// (declared in plan.h).
 //
 // The general format is for the user to
 // input a specific flag into the functions.
@@ -17,10 +20,25 @@ namespace et{
 // Provides an interface for the et::expression evaluation
 // pipeline. This is to abstract away the construction of
 // an expression and choose the method of evaluation.
-double eval(var& v, bool iter);
+//
+// By default, the graph is evaluated depth-first from the root
+// (see expression::propagate()), which handles graphs of any depth.
+// iter=true evaluates it bottom-up from the leaves instead.
+double eval(var& v, bool iter = false);
+
+// Evaluates the graph a level at a time, spreading the wide
+// levels over the threads of the pool (see et::level_schedule).
+// steal=true runs every node as soon as its operands are ready
+// instead (see et::propagate_stealing()), which suits graphs
+// with ragged levels better.
+double eval(var& v, thread_pool& pool, bool steal = false);
 
 // Provides an interface for the et::expression backprop
 // pipeline.
+//
+// Like expression::backpropagate(), every back() reads the values
+// stored in the nodes: call eval() first, and again whenever a leaf
+// changes, or the derivatives are those of the old values.
 
 enum class back_flags {
     const_qualify
@@ -28,4 +46,48 @@ enum class back_flags {
 
 void back(const var&, std::unordered_map<var, double>&, std::set<back_flags> flags = {});
 
+// Same, into an array: gradient[k] gets the derivative w.r.t. leaves[k]
+// (0 if it is not part of the graph). gradient must have room for
+// leaves.size() doubles.
+// This still builds a graph_index, which hashes every node, and looks
+// up every leaf in it.
+void back(const var&, const std::vector<var>& leaves, double* gradient);
+
+// Same, over an index that is built once and reused: leaf_ids are ids
+// in g (from graph_index::find(), npos gives 0), so nothing is hashed.
+// Re-evaluate the graph (e.g. propagate_levels() over g) between calls,
+// as for every back().
+void back(const graph_index& g, const std::vector<uint32_t>& leaf_ids, double* gradient);
+
+// Backprop over the threads of the pool, with every node run as soon
+// as all of its parents are done (see et::backpropagate_stealing()).
+void back(const var&, std::unordered_map<var, double>&, thread_pool& pool);
+
+enum class jacobian_mode {
+    automatic,
+    forward,
+    reverse
+};
+
+// The derivatives of every root w.r.t. every leaf, as a dense
+// row-major roots.size() x leaves.size() matrix: the entry at
+// i * leaves.size() + j is d roots[i] / d leaves[j].
+//
+// The roots share one graph_index and one forward pass, which uses the
+// current values of the leaves (the graph need not be evaluated first,
+// and is left as is). The derivatives then take one sweep over the
+// nodes per block of jacobian_lanes seeds, every node handling all of
+// the lanes at once:
+// - reverse mode seeds roots, and sweeps from the roots down,
+// - forward mode seeds leaves, and sweeps from the leaves up.
+// automatic picks forward mode when there are fewer leaves than roots.
+//
+// Throws std::invalid_argument if one of the leaves has operands.
+std::vector<double> jacobian(const std::vector<var>& roots,
+        const std::vector<var>& leaves,
+        jacobian_mode mode = jacobian_mode::automatic);
+
+// Seeds per sweep of et::jacobian().
+const size_t jacobian_lanes = 8;
+
 }
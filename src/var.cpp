@@ -1,21 +1,50 @@
 #include "var.h"
-#include <map>
+#include "memory.h"
+#include <atomic>
 
 namespace et{
-/* enum find */
-
-int numOpArgs(op_type op){
-    static const std::map<op_type, int> op_args = {
-        { op_type::plus, 2 },
-        { op_type::minus, 2 },
-        { op_type::multiply, 2 },
-        { op_type::divide, 2 },
-        { op_type::exponent, 1 },
-        { op_type::polynomial, 1 },
-        { op_type::none, 0 },
-    };
-    return op_args.find(op)->second;
-};
+/* et::var allocation: */
+template <typename... Args>
+var::impl_ptr var::make_impl(Args&&... args){
+    graph_arena* arena = graph_arena::current();
+    node_allocator<impl> alloc(arena ? arena->getState() : nullptr);
+    impl* p = alloc.allocate(1);
+    try{
+        new (p) impl(std::forward<Args>(args)...);
+    }
+    catch(...){
+        alloc.deallocate(p, 1);
+        throw;
+    }
+    p->arena = alloc.arena;
+    track_node_alloc(sizeof(impl));
+    return impl_ptr(p);
+}
+
+// Destroying a node releases its children, which may in turn destroy
+// them, and so on: done recursively, freeing a long chain overflows the
+// stack. Instead, the outermost release() on a thread drains a queue of
+// dead nodes, and the releases nested in it only add to that queue.
+void var::impl::release(impl* p){
+    static thread_local impl* released = nullptr;
+    static thread_local bool releasing = false;
+
+    p->next_released = released;
+    released = p;
+    if(releasing)
+        return;
+
+    releasing = true;
+    while(released){
+        impl* q = released;
+        released = q->next_released;
+        node_allocator<impl> alloc(q->arena);
+        track_node_free(sizeof(impl));
+        q->~impl();
+        alloc.deallocate(q, 1);
+    }
+    releasing = false;
+}
 
 /* et::var default funcs: */
 
@@ -28,63 +57,96 @@ var::var(const var&) = default;
 var& var::operator=(const var&) = default;
 // deep copyable
 var var::clone(){
-    return var(std::make_shared<impl>(*pimpl)); 
+    return var(make_impl(*pimpl)); 
 }
 
 /* et::var funcs: */
-var::var(std::shared_ptr<impl> _pimpl) : pimpl(_pimpl){};
+var::var(impl_ptr _pimpl) : pimpl(_pimpl){};
 
 var::var(double _val) 
-: pimpl(new impl(_val)){}
+: pimpl(make_impl(_val)){}
 
 var::var(op_type _op, const std::vector<var>& _children)
-: pimpl(new impl(_op, _children)){}
+: pimpl(make_impl(_op, _children)){}
+
+var::var(op_type _op, const var& v)
+: pimpl(make_impl(_op, v)){}
+
+var::var(op_type _op, const var& lhs, const var& rhs)
+: pimpl(make_impl(_op, lhs, rhs)){}
 
 /* getters and setters */
 double var::getValue() const{ return pimpl->val; }
 
-void var::setValue(double _val){ pimpl->val = _val; }
+void var::setValue(double _val){
+    pimpl->val = _val;
+    pimpl->version++;
+}
+
+unsigned var::getVersion() const{ return pimpl->version; }
+
+uint64_t var::newEpoch(){
+    // Epoch 0 is what fresh nodes are stamped with.
+    static std::atomic<uint64_t> epochs(1);
+    return epochs.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool var::visit(uint64_t epoch) const{
+    if(pimpl->epoch == epoch)
+        return true;
+    pimpl->epoch = epoch;
+    return false;
+}
 
 op_type var::getOp() const{ return pimpl->op; }
 
 void var::setOp(op_type _op){ pimpl->op = _op; }
 
-std::vector<var>& var::getChildren() const{ return pimpl->children; }
-
-std::vector<var> var::getParents() const{
-    std::vector<var> _parents;
-    for( std::weak_ptr<impl> parent : pimpl->parents ){
-        _parents.emplace_back( parent.lock() );
-    } 
-    return _parents;
-}
+var::children_type& var::getChildren() const{ return pimpl->children; }
 
 long var::getUseCount() const{
     return pimpl.use_count();
 }
 
+size_t var::getNodeSize(){ return sizeof(impl); }
+
 /* hash/comparisons */
 bool var::operator==(const var& rhs) const{ return pimpl.get() == rhs.pimpl.get(); }
 
 /* et::var::impl funcs: */
 var::impl::impl(double _val) : 
     val(_val), 
-    op(op_type::none){}
+    op(op_type::none),
+    version(0),
+    epoch(0),
+    arena(nullptr){}
 
 var::impl::impl(op_type _op, const std::vector<var>& _children)
-: op(_op) {
+: val(0), op(_op), version(0), epoch(0), arena(nullptr) {
+    children.reserve(_children.size());
     for(const var& v : _children){
         children.emplace_back(v.pimpl);
     }
 }
 
+var::impl::impl(op_type _op, const var& v)
+: val(0), op(_op), version(0), epoch(0), arena(nullptr) {
+    children.emplace_back(v.pimpl);
+}
+
+var::impl::impl(op_type _op, const var& lhs, const var& rhs)
+: val(0), op(_op), version(0), epoch(0), arena(nullptr) {
+    children.emplace_back(lhs.pimpl);
+    children.emplace_back(rhs.pimpl);
+}
+
 }
 
 namespace std{
 
 // Template specialize hash for vars
 size_t hash<et::var>::operator()(const et::var& v) const{
-    return std::hash<std::shared_ptr<et::var::impl> >{}(v.pimpl);
+    return std::hash<et::var::impl*>{}(v.pimpl.get());
 }
 
 }
@@ -9,34 +9,20 @@
  #define D if(0) 
 #endif
 // enddebug
+#include "arena.h"
+#include "intrusive_ptr.h"
+#include "op.h"
+#include "small_vector.h"
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <cstdint>
 #include <utility>
 
 namespace et{
 // forward declare class var
 class var;
 
-// Current support for operators:
-// operator+
-// operator-
-// operator*
-// operator/
-// exp() // e^x
-// poly() // x^n
-enum class op_type {
-    plus,
-    minus,
-    multiply,
-    divide,
-    exponent,
-    polynomial,
-    none // no operators. leaf.
-};
-
-int numOpArgs(op_type op);
-
 }
 
 namespace std{
@@ -84,11 +70,20 @@ class var {
 struct impl;
 
 public:
+    // The children of a node are stored inline in the node.
+    typedef small_vector<var, 2> children_type;
+
+    // Nodes are refcounted intrusively. See et::refcount for
+    // the single-threaded (non-atomic) policy.
+    typedef intrusive_ptr<impl> impl_ptr;
+
     // For initialization of new vars by ptr
-    var(std::shared_ptr<impl>);
+    var(impl_ptr);
 
     var(double);
     var(op_type, const std::vector<var>&);
+    var(op_type, const var&);
+    var(op_type, const var&, const var&);
     ~var();
 
     // movable
@@ -105,23 +100,37 @@ public:
     // Access/Modify the current node value
     double getValue() const;
     void setValue(double);
+
+    // Bumped by every setValue(), so that compiled plans can
+    // tell which leaves changed since they last looked.
+    unsigned getVersion() const;
+
+    // Traversals that need to visit every node once get a fresh
+    // epoch from newEpoch(), and stamp the nodes with it as they go.
+    // visit() stamps the node, and returns whether it already was,
+    // so no visited set needs to be allocated.
+    static uint64_t newEpoch();
+    bool visit(uint64_t epoch) const;
+
     op_type getOp() const;
     void setOp(op_type);
     
     // Access internals (no modify)
     
     // We return by reference because we do not
-    // want to increase the shared_ptr count.
+    // want to increase the refcount.
     // (Even though it's innocuous so far)
-    std::vector<var>& getChildren() const;
+    children_type& getChildren() const;
+
+    // Nodes do not keep track of their parents.
+    // Use an et::graph_index to walk the graph upwards.
 
-    // We return by copy here because we want
-    // to let the user know that the shared_ptr
-    // count is increased for the duration that
-    // the parents are held.
-    std::vector<var> getParents() const;
     long getUseCount() const;
 
+    // The size of a single node, not counting children
+    // that spilled onto the heap. See et::memory_stats().
+    static size_t getNodeSize();
+
     // Comparison for hash
     bool operator==(const var& rhs) const;
     friend struct std::hash<var>;
@@ -132,8 +141,13 @@ public:
     template <typename... V>
     friend const var pack_expression(op_type, V&...);
 private: 
+    // Allocates a node, from the current et::graph_arena if
+    // there is one on this thread.
+    template <typename... Args>
+    static impl_ptr make_impl(Args&&...);
+
     // PImpl idiom requires forward declaration of the class:
-    std::shared_ptr<impl> pimpl;
+    impl_ptr pimpl;
 };
 
 struct var::impl{
@@ -142,6 +156,11 @@ public:
     // Or allow to enter operation and children(parent)
     impl(double);
     impl(op_type, const std::vector<var>&);
+    impl(op_type, const var&);
+    impl(op_type, const var&, const var&);
+
+    // Called by intrusive_ptr once the last reference is gone.
+    static void release(impl*);
 
     // The value that the variable currently holds.
     // Currently only supports double.
@@ -154,29 +173,34 @@ public:
     // an op value of var::op::plus
     op_type op; 
 
+    // Number of times setValue() was called on this node.
+    unsigned version;
+
+    union{
+        // The last traversal that visited this node.
+        uint64_t epoch;
+        // Once released, nodes are not visited anymore and are
+        // linked into the queue of nodes to destroy instead.
+        impl* next_released;
+    };
+
     // The children of the current variable, 
     // i.e. which variables make up this variable.
-    std::vector<var> children;
+    // Up to 2 of them are held inline without any allocation.
+    children_type children;
+
+    // The number of vars referring to this node.
+    refcount refs;
 
-    // TODO: Currently the API supports pointing weak_ptrs.
-    // This way, we won't have the issue with shared_ptr loops.
-    // We should devise a cleaner way to do this if possible.
-    std::vector<std::weak_ptr<impl>> parents;
+    // The arena the node was allocated from, or nullptr
+    // if it came from the heap.
+    arena_state* arena;
 };
 
 // Inline definitions of templated functions:
 template <typename... V>
 const var pack_expression(op_type op, V&... args){
-    std::vector<std::shared_ptr<var::impl> > vimpl = { args.pimpl... };
-    std::vector<var> v;
-    for(const std::shared_ptr<var::impl>& _impl : vimpl){
-        v.emplace_back(_impl); 
-    }
-    var res(op, v);
-    for(const std::shared_ptr<var::impl>& _impl : vimpl){
-        _impl->parents.push_back(res.pimpl);
-    }
-    return res;
+    return var(op, args...);
 }
 
 // We need const-ness in returns here to prevent things like:
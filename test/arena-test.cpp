@@ -0,0 +1,153 @@
+#include "catch.hpp"
+#include "../src/utils.h"
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+#define NEW_CASE std::cout<<"======="<<std::endl;
+#define NEW_SEC  std::cout<<"-------"<<std::endl;
+
+// Count the calls into the global allocator.
+static size_t allocations = 0;
+
+void* operator new(size_t bytes){
+    allocations++;
+    if(void* p = std::malloc(bytes ? bytes : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept{ std::free(p); }
+
+TEST_CASE( "et::graph_arena is scoped.", "[et::graph_arena::graph_arena]" ) {
+    REQUIRE(et::graph_arena::current() == nullptr);
+
+    SECTION( "The arena is current while it is alive." ){
+        {
+            et::graph_arena arena;
+            REQUIRE(et::graph_arena::current() == &arena);
+        }
+        REQUIRE(et::graph_arena::current() == nullptr);
+    }
+
+    SECTION( "Arenas nest." ){
+        et::graph_arena outer;
+        {
+            et::graph_arena inner;
+            REQUIRE(et::graph_arena::current() == &inner);
+        }
+        REQUIRE(et::graph_arena::current() == &outer);
+    }
+}
+
+TEST_CASE( "et::graph_arena allocates the nodes.", "[et::graph_arena::allocate]" ) {
+    SECTION( "Nodes created in the scope come from the arena." ){
+        et::graph_arena arena;
+        et::var a(1), b(2);
+        REQUIRE(arena.getLiveCount() == 2);
+        size_t used = arena.getBytesUsed();
+        et::var c = a + b;
+        REQUIRE(arena.getLiveCount() == 3);
+        REQUIRE(arena.getBytesUsed() > used);
+    }
+
+    SECTION( "Nodes created outside of the scope do not." ){
+        et::var a(1);
+        et::graph_arena arena;
+        et::var b = a.clone();
+        REQUIRE(arena.getLiveCount() == 1);
+    }
+
+    SECTION( "Destroyed nodes are given back." ){
+        et::graph_arena arena;
+        {
+            et::var a(1), b(2);
+            et::var c = a * b;
+        }
+        REQUIRE(arena.getLiveCount() == 0);
+    }
+
+    SECTION( "Large allocations do not overflow a block." ){
+        et::graph_arena arena(64);
+        std::vector<et::var> v;
+        for(int i = 0; i < 100; i++)
+            v.push_back(et::var(i));
+        for(int i = 0; i < 100; i++)
+            REQUIRE(v[i].getValue() == i);
+    }
+}
+
+TEST_CASE( "et::graph_arena graphs can be evaluated.", "[et::graph_arena::eval]" ) {
+    SECTION( "A graph built in an arena evaluates and differentiates." ){
+        et::graph_arena arena;
+        et::var x(0.5);
+        et::var fx = et::poly(et::exp(3*x + 1), 2.5)/10 + 10;
+        std::unordered_map<et::var, double> m = {
+            { x, 0 },
+        };
+        et::eval(fx, true);
+        et::back(fx, m);
+        REQUIRE(std::abs(m[x] - ((3.0/4)*std::exp(7.5*0.5 + 2.5))) < 1e-10);
+    }
+
+    SECTION( "Nodes may outlive the arena scope." ){
+        et::var root(0);
+        {
+            et::graph_arena arena;
+            et::var a(1), b(2), c(3);
+            root = (a + b) * c;
+        }
+        REQUIRE(et::eval(root, false) == 9);
+        REQUIRE(root.getChildren()[0].getChildren()[1].getValue() == 2);
+    }
+}
+
+TEST_CASE( "Released nodes are recycled.", "[et::pool_allocate]" ) {
+    auto build = []() -> double{
+        et::var x(0.5), y(2);
+        et::var fx = et::poly(et::exp(3*x + 1), y)/10 + x*y;
+        return fx.getChildren()[1].getValue();
+    };
+
+    SECTION( "Destroyed nodes go back to the thread's free lists." ){
+        et::trim_node_pool();
+        build();
+        size_t cached = et::node_pool_size();
+        REQUIRE(cached > 0);
+        build();
+        REQUIRE(et::node_pool_size() == cached);
+        et::trim_node_pool();
+        REQUIRE(et::node_pool_size() == 0);
+    }
+
+    SECTION( "The free lists are bounded." ){
+        et::trim_node_pool();
+        {
+            std::vector<et::var> v;
+            for(size_t i = 0; i < 2 * et::node_pool_limit; i++)
+                v.push_back(et::var(i));
+        }
+        REQUIRE(et::node_pool_size() == et::node_pool_limit);
+        et::trim_node_pool();
+    }
+
+    SECTION( "A graph of the same shape does not call the allocator again." ){
+        build();
+        size_t before = allocations;
+        for(int i = 0; i < 10; i++)
+            build();
+        REQUIRE(allocations == before);
+    }
+
+    SECTION( "Spilled children are recycled too." ){
+        auto spill = []() -> size_t{
+            et::var a(1), b(2), c(3);
+            et::var root(et::op_type::plus, {a, b, c});
+            return root.getChildren().size();
+        };
+        spill();
+        size_t cached = et::node_pool_size();
+        REQUIRE(spill() == 3);
+        REQUIRE(et::node_pool_size() == cached);
+    }
+}
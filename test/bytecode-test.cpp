@@ -0,0 +1,83 @@
+#include "catch.hpp"
+#include "../src/bytecode.h"
+#include "../src/utils.h"
+#include <cmath>
+
+#define NEW_CASE std::cout<<"======="<<std::endl;
+#define NEW_SEC  std::cout<<"-------"<<std::endl;
+
+TEST_CASE( "et::bytecode compiles one instruction per operator.", "[et::bytecode::bytecode]" ) {
+    et::var a(1), b(2);
+    et::var ab = a * b;
+    et::var root = ab + et::exp(ab);
+    et::bytecode code(root);
+
+    REQUIRE(code.numRegisters() == 5);
+    REQUIRE(code.size() == 3);
+
+    SECTION( "Instructions are framed by halts, in topological order." ){
+        const std::vector<et::instruction>& c = code.getCode();
+        REQUIRE(c.size() == 5);
+        REQUIRE(c.front().op == et::opcode::halt);
+        REQUIRE(c.back().op == et::opcode::halt);
+        REQUIRE(c[1].op == et::opcode::mul);
+        REQUIRE(c[2].op == et::opcode::exp);
+        REQUIRE(c[2].lhs == c[1].dst);
+        REQUIRE(c[3].op == et::opcode::add);
+        REQUIRE(c[3].dst == 4);
+    }
+
+    SECTION( "Only unary and binary operators are supported." ){
+        et::var nary(et::op_type::plus, {a, b, ab});
+        REQUIRE_THROWS(et::bytecode(nary));
+    }
+}
+
+TEST_CASE( "et::bytecode can evaluate forward.", "[et::bytecode::forward]" ) {
+    et::var x(2), y(3);
+    et::var fx = et::poly(et::exp(x/y), 2) - x*y + 1/(y - x);
+    et::bytecode code(fx);
+
+    for(int i = 0; i < 5; i++){
+        x.setValue(0.1 * i);
+        double got = code.forward();
+        REQUIRE(got == et::eval(fx));
+        REQUIRE(code.getValue(fx) == got);
+        REQUIRE(code.getValue(x) == 0.1 * i);
+    }
+
+    SECTION( "The graph is not written to." ){
+        x.setValue(7);
+        code.forward();
+        REQUIRE(fx.getValue() != code.getValue(fx));
+    }
+
+    SECTION( "Nodes outside of the graph cannot be looked up." ){
+        REQUIRE_THROWS(code.getValue(et::var(1)));
+    }
+}
+
+TEST_CASE( "et::bytecode can find the derivatives.", "[et::bytecode::backward]" ) {
+    SECTION( "d/dx of poly(exp(3x+1), 2.5)/10 + 10" ){
+        et::var x(0.5);
+        et::var fx = et::poly(et::exp(3*x + 1), 2.5)/10 + 10;
+        et::bytecode code(fx);
+        code.forward();
+        code.backward();
+        REQUIRE(std::abs(code.getDerivative(x) - (3.0/4)*std::exp(7.5*0.5 + 2.5)) < 1e-10);
+        REQUIRE(code.getDerivative(fx) == 1);
+    }
+
+    SECTION( "Shared nodes and repeated operands add up." ){
+        et::var x(3), y(2);
+        et::var s = x * y;
+        et::var fx = s*s + s/y - x*x;
+        et::bytecode code(fx);
+        code.forward();
+        code.backward();
+        // fx = x^2 y^2 + x - x^2
+        REQUIRE(std::abs(code.getDerivative(x) - (2*3*4 + 1 - 2*3)) < 1e-12);
+        REQUIRE(std::abs(code.getDerivative(y) - (2*9*2)) < 1e-12);
+        REQUIRE(std::abs(code.getDerivative(s) - (2*6 + 0.5)) < 1e-12);
+    }
+}
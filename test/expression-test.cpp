@@ -316,3 +316,93 @@ TEST_CASE( "et::expression can find the derivatives with nonconst optimizations.
         REQUIRE(m[a]-grad < 1e-10);
     }
 }
+
+TEST_CASE( "et::expression evaluates poly() with a computed exponent *ITERATIVELY*.", "[et::expression::propagate]") {
+    et::var a(2), b(1), c(2);
+    et::var root = et::poly(a, b + c);
+    et::expression exp(root);
+    REQUIRE(exp.propagate(exp.findLeaves()) == 8);
+}
+
+TEST_CASE( "et::expression evaluates shared nodes once *RECURSIVELY*.", "[et::expression::propagate]") {
+    // Without memoization this would take 2^64 evaluations.
+    et::var x(1.0001);
+    et::var y = x * x;
+    for(int i = 0; i < 63; i++)
+        y = y * y;
+    et::expression exp(y);
+    double val = exp.propagate();
+    REQUIRE(val == y.getValue());
+    REQUIRE(y.getChildren()[0].getValue() == y.getChildren()[1].getValue());
+
+    SECTION( "Later calls see new leaf values." ){
+        x.setValue(1);
+        REQUIRE(exp.propagate() == 1);
+    }
+}
+
+TEST_CASE( "et::expression expands shared nodes once when finding the derivatives.", "[et::expression::backpropagate]") {
+    // y = x^(2^40), through 40 squarings of a shared node.
+    et::var x(1);
+    et::var y = x * x;
+    for(int i = 1; i < 40; i++)
+        y = y * y;
+    et::expression exp(y);
+    exp.propagate();
+
+    SECTION( "Every path is counted exactly once." ){
+        std::unordered_map<et::var, double> m = {
+            { x, 0 },
+        };
+        exp.backpropagate(m);
+        REQUIRE(m[x] == std::pow(2.0, 40));
+    }
+
+    SECTION( "Also with the nonconst optimization." ){
+        std::unordered_map<et::var, double> m = {
+            { x, 0 },
+        };
+        exp.backpropagate(m, exp.findNonConsts({x}));
+        REQUIRE(m[x] == std::pow(2.0, 40));
+    }
+
+    SECTION( "Diamonds add up their branches." ){
+        et::var a(2), b(3);
+        et::var s = a * b;
+        et::var root = s + et::exp(s) + s * a;
+        std::unordered_map<et::var, double> m = {
+            { a, 0 },
+            { b, 0 },
+        };
+        et::expression e(root);
+        e.propagate();
+        e.backpropagate(m);
+        // root = ab + e^(ab) + a^2 b
+        REQUIRE(std::abs(m[a] - (3 + 3*std::exp(6) + 2*2*3)) < 1e-9);
+        REQUIRE(std::abs(m[b] - (2 + 2*std::exp(6) + 4)) < 1e-9);
+    }
+}
+
+TEST_CASE( "The fused backward kernels agree with the per-operand partials.", "[et::_back_fused]") {
+    const et::op_type ops[] = {
+        et::op_type::plus, et::op_type::minus, et::op_type::multiply,
+        et::op_type::divide, et::op_type::exponent, et::op_type::polynomial
+    };
+    double lhs = 1.5, rhs = 2.5, adjoint = 0.75;
+    for(et::op_type op : ops){
+        double out = et::_eval(op, lhs, rhs);
+        double dl = 1, dr = 1;
+        et::_back_fused(op, lhs, rhs, out, adjoint, dl, dr);
+        REQUIRE(std::abs(dl - (1 + adjoint * et::_back_single(op, lhs, rhs, 0))) < 1e-12);
+        if(et::numOpArgs(op) == 2 && et::getOpInfo(op).differentiable)
+            REQUIRE(std::abs(dr - (1 + adjoint * et::_back_single(op, lhs, rhs, 1))) < 1e-12);
+        else
+            REQUIRE(dr == 1);
+    }
+
+    SECTION( "Both operands can share one adjoint." ){
+        double d = 0;
+        et::_back_fused(et::op_type::multiply, lhs, lhs, lhs * lhs, 1, d, d);
+        REQUIRE(d == 2 * lhs);
+    }
+}
@@ -0,0 +1,102 @@
+#include "catch.hpp"
+#include "../src/graph.h"
+
+#define NEW_CASE std::cout<<"======="<<std::endl;
+#define NEW_SEC  std::cout<<"-------"<<std::endl;
+
+TEST_CASE( "et::graph_index numbers the nodes.", "[et::graph_index::graph_index]" ) {
+    et::var a(10), b(5), c(15), d(2);
+    et::var a_b = a + b;
+    et::var c_d = c + d;
+    et::var root = a_b + c_d;
+    et::graph_index g(root);
+
+    REQUIRE(g.size() == 7);
+
+    SECTION( "The root has the largest id." ){
+        REQUIRE(g.getRoot() == 6);
+        REQUIRE(g.getNode(g.getRoot()) == root);
+    }
+
+    SECTION( "Children come before their parents." ){
+        for(uint32_t id = 0; id < g.size(); id++){
+            for(const uint32_t* c = g.childrenBegin(id); c != g.childrenEnd(id); c++)
+                REQUIRE(*c < id);
+        }
+    }
+
+    SECTION( "Nodes can be found by var." ){
+        REQUIRE(g.getNode(g.find(c_d)) == c_d);
+        REQUIRE(g.find(et::var(3)) == et::graph_index::npos);
+    }
+
+    SECTION( "Child edges are in operand order." ){
+        uint32_t id = g.find(a_b);
+        REQUIRE(g.childrenEnd(id) - g.childrenBegin(id) == 2);
+        REQUIRE(g.getNode(g.childrenBegin(id)[0]) == a);
+        REQUIRE(g.getNode(g.childrenBegin(id)[1]) == b);
+    }
+}
+
+TEST_CASE( "et::graph_index can index several roots.", "[et::graph_index::graph_index]" ) {
+    et::var a(10), b(5), c(15);
+    et::var a_b = a * b;
+    et::var f = a_b + c;
+    et::var h = et::exp(a_b);
+    et::graph_index g({f, h, a_b});
+
+    // a, b, a*b, c, f, then exp(a*b).
+    REQUIRE(g.size() == 6);
+    REQUIRE(g.getNode(g.getRoot()) == h);
+    REQUIRE(g.find(f) < g.find(h));
+
+    SECTION( "Children come before their parents." ){
+        for(uint32_t id = 0; id < g.size(); id++){
+            for(const uint32_t* c = g.childrenBegin(id); c != g.childrenEnd(id); c++)
+                REQUIRE(*c < id);
+        }
+    }
+
+    SECTION( "There must be at least one root." ){
+        REQUIRE_THROWS(et::graph_index(std::vector<et::var>()));
+    }
+}
+
+TEST_CASE( "et::graph_index finds the parents.", "[et::graph_index::parentsBegin]" ) {
+    SECTION( "Shared nodes have all their parents." ){
+        et::var a(1),b(3),c(2),d(4);
+        et::var x = a + b;
+        et::var y = c + d;
+        et::var z = x + y;
+        et::var w = y + 5;
+        z.setValue(0.5);
+        w.setValue(0.2);
+        et::graph_index g(z * w);
+
+        uint32_t id = g.find(y);
+        REQUIRE(g.parentsEnd(id) - g.parentsBegin(id) == 2);
+        REQUIRE(g.getNode(g.parentsBegin(id)[0]).getValue() == 0.5);
+        REQUIRE(g.getNode(g.parentsBegin(id)[1]).getValue() == 0.2);
+        REQUIRE(g.parentsBegin(g.getRoot()) == g.parentsEnd(g.getRoot()));
+    }
+
+    SECTION( "An operand used twice is two edges." ){
+        et::var x(3);
+        et::var root = x * x;
+        et::graph_index g(root);
+
+        REQUIRE(g.size() == 2);
+        uint32_t id = g.find(x);
+        REQUIRE(g.parentsEnd(id) - g.parentsBegin(id) == 2);
+    }
+
+    SECTION( "Deep graphs do not overflow the stack." ){
+        et::var x(1);
+        et::var root = x;
+        for(int i = 0; i < 100000; i++)
+            root = root + x;
+        et::graph_index g(root);
+        REQUIRE(g.size() == 100001);
+        REQUIRE(g.parentsEnd(g.find(x)) - g.parentsBegin(g.find(x)) == 100001);
+    }
+}
@@ -0,0 +1,137 @@
+#include "catch.hpp"
+#include "../src/jit.h"
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define NEW_CASE std::cout<<"======="<<std::endl;
+#define NEW_SEC  std::cout<<"-------"<<std::endl;
+
+// A cache of our own, so that every run starts out empty.
+static et::jit_options test_options(){
+    et::jit_options options;
+    options.cache_dir = "/tmp/et-jit-test-" + std::to_string(getpid());
+    return options;
+}
+
+static et::var build(et::var& x, et::var& y){
+    et::var s = x * y;
+    return et::poly(et::exp(x / 4), 2) + s*s - x / (y + 1);
+}
+
+TEST_CASE( "et::jit generates straight-line code.", "[et::jit_function::generate]" ) {
+    et::var x(1), y(2);
+    et::bytecode code(x * y + et::exp(x));
+    std::string src = et::jit_function::generate(code);
+    REQUIRE(src.find("extern \"C\" void et_forward(double* r)") != std::string::npos);
+    REQUIRE(src.find("extern \"C\" void et_backward(const double* r, double* a)") != std::string::npos);
+    REQUIRE(src.find("std::exp(") != std::string::npos);
+    REQUIRE(src.find("et_registers = " + std::to_string(code.numRegisters()) + "ULL") != std::string::npos);
+    REQUIRE(src.find("et_leaves = 2ULL") != std::string::npos);
+}
+
+TEST_CASE( "et::jit hashes the structure of the graph.", "[et::jit_function::hash]" ) {
+    et::var a(1), b(2), c(3), d(4);
+    et::bytecode ab(a * b), cd(c * d), sum(a + b);
+    REQUIRE(et::jit_function::hash(ab) == et::jit_function::hash(cd));
+    REQUIRE(et::jit_function::hash(ab) != et::jit_function::hash(sum));
+}
+
+TEST_CASE( "et::jit agrees with the interpreter.", "[et::jit]" ) {
+    et::jit_options options = test_options();
+    et::var x(0.5), y(1.5);
+    et::var f = build(x, y);
+    et::bytecode code(f);
+    et::jit_function fn = et::jit(f, options);
+
+    REQUIRE(fn.isNative());
+    REQUIRE(!fn.isCached());
+    REQUIRE(access(fn.getLibraryPath().c_str(), R_OK) == 0);
+
+    for(int i = 0; i < 5; i++){
+        x.setValue(0.1 * i);
+        REQUIRE(fn.forward() == code.forward());
+        fn.backward();
+        code.backward();
+        REQUIRE(fn.getValue(f) == code.getValue(f));
+        REQUIRE(fn.getDerivative(x) == code.getDerivative(x));
+        REQUIRE(fn.getDerivative(y) == code.getDerivative(y));
+    }
+
+    SECTION( "Graphs of the same shape come out of the cache." ){
+        et::var u(3), v(4);
+        et::var g = build(u, v);
+        et::jit_function other = et::jit(g, options);
+        REQUIRE(other.isNative());
+        REQUIRE(other.isCached());
+        REQUIRE(other.getHash() == fn.getHash());
+        REQUIRE(other.getLibraryPath() == fn.getLibraryPath());
+        et::bytecode check(g);
+        REQUIRE(other.forward() == check.forward());
+    }
+
+    SECTION( "Without a compiler, the interpreter takes over." ){
+        et::jit_options broken = test_options();
+        broken.cache_dir += "-broken";
+        broken.compiler = "/nonexistent/c++";
+        et::jit_function slow = et::jit(f, broken);
+        REQUIRE(!slow.isNative());
+        REQUIRE(slow.getLibraryPath() == "");
+        REQUIRE(slow.forward() == code.forward());
+        slow.backward();
+        code.backward();
+        REQUIRE(slow.getDerivative(x) == code.getDerivative(x));
+        rmdir(broken.cache_dir.c_str());
+    }
+
+    SECTION( "The cache is private." ){
+        struct stat st;
+        REQUIRE(stat(options.cache_dir.c_str(), &st) == 0);
+        REQUIRE((st.st_mode & 0777) == 0700);
+    }
+
+    SECTION( "A cache others can write to is not used." ){
+        et::jit_options shared = test_options();
+        shared.cache_dir += "-shared";
+        REQUIRE(mkdir(shared.cache_dir.c_str(), 0700) == 0);
+        REQUIRE(chmod(shared.cache_dir.c_str(), 0777) == 0);
+        et::jit_function refused = et::jit(f, shared);
+        REQUIRE(!refused.isNative());
+        REQUIRE(refused.forward() == code.forward());
+        rmdir(shared.cache_dir.c_str());
+    }
+
+    SECTION( "A library that does not match the graph is not run." ){
+        et::var u(3);
+        et::var g = et::exp(u) * u;
+        std::string path = et::jit(g, options).getLibraryPath();
+        REQUIRE(path != "");
+        // Stands in for a hash collision, or a stale file.
+        {
+            std::ifstream src(fn.getLibraryPath(), std::ios::binary);
+            std::ofstream dst(path, std::ios::binary | std::ios::trunc);
+            dst << src.rdbuf();
+        }
+        REQUIRE(chmod(path.c_str(), 0600) == 0);
+        et::jit_function foreign = et::jit(g, options);
+        REQUIRE(!foreign.isNative());
+        et::bytecode check(g);
+        REQUIRE(foreign.forward() == check.forward());
+        std::remove(path.c_str());
+    }
+
+    SECTION( "Paths with quotes in them are passed to the compiler as they are." ){
+        et::jit_options quoted = test_options();
+        quoted.cache_dir += "-it's";
+        et::jit_function q = et::jit(f, quoted);
+        REQUIRE(q.isNative());
+        REQUIRE(q.forward() == code.forward());
+        std::remove(q.getLibraryPath().c_str());
+        rmdir(quoted.cache_dir.c_str());
+    }
+
+    std::remove(fn.getLibraryPath().c_str());
+    rmdir(options.cache_dir.c_str());
+}
@@ -0,0 +1,130 @@
+#include "catch.hpp"
+#include "../src/utils.h"
+#include "../src/memory.h"
+#include <thread>
+
+#define NEW_CASE std::cout<<"======="<<std::endl;
+#define NEW_SEC  std::cout<<"-------"<<std::endl;
+
+TEST_CASE( "et::get_memory_counters tracks the live nodes.", "[et::get_memory_counters]" ) {
+    et::memory_counters before = et::get_memory_counters();
+
+    SECTION( "Nodes are counted while they are alive." ){
+        {
+            et::var a(1), b(2);
+            et::var c = a + b;
+            et::memory_counters during = et::get_memory_counters();
+            REQUIRE(during.live_nodes == before.live_nodes + 3);
+            REQUIRE(during.live_bytes == before.live_bytes + 3 * et::var::getNodeSize());
+            REQUIRE(during.total_nodes == before.total_nodes + 3);
+            REQUIRE(during.peak_nodes >= during.live_nodes);
+        }
+        et::memory_counters after = et::get_memory_counters();
+        REQUIRE(after.live_nodes == before.live_nodes);
+        REQUIRE(after.live_bytes == before.live_bytes);
+    }
+
+    SECTION( "The peak survives the nodes, until it is reset." ){
+        {
+            std::vector<et::var> v;
+            for(int i = 0; i < 100; i++)
+                v.push_back(et::var(i));
+        }
+        REQUIRE(et::get_memory_counters().peak_nodes >= before.live_nodes + 100);
+        et::reset_peak_memory();
+        REQUIRE(et::get_memory_counters().peak_nodes == before.live_nodes);
+
+        // The peak starts over from the reset, not from the old peak.
+        {
+            std::vector<et::var> v;
+            for(int i = 0; i < 10; i++)
+                v.push_back(et::var(i));
+        }
+        REQUIRE(et::get_memory_counters().peak_nodes == before.live_nodes + 10);
+    }
+
+    SECTION( "A graph kept alive by a copy is not leaked once the copy is gone." ){
+        et::var* held;
+        {
+            et::var x(1);
+            et::var root = et::exp(x) * x;
+            et::eval(root, true);
+            held = new et::var(root);
+        }
+        REQUIRE(et::get_memory_counters().live_nodes == before.live_nodes + 3);
+        delete held;
+        REQUIRE(et::get_memory_counters().live_nodes == before.live_nodes);
+    }
+    SECTION( "Very deep graphs are freed in full." ){
+        {
+            et::var x(1);
+            et::var root = x;
+            for(int i = 0; i < 1000000; i++)
+                root = et::exp(root);
+            REQUIRE(et::get_memory_counters().live_nodes == before.live_nodes + 1000001);
+        }
+        REQUIRE(et::get_memory_counters().live_nodes == before.live_nodes);
+    }
+}
+
+TEST_CASE( "et::memory_stats measures a graph.", "[et::memory_stats]" ) {
+    SECTION( "et::memory_stats counts nodes and edges of a+b+c+d" ){
+        et::var a(10), b(5), c(15), d(2);
+        et::var root = (a + b) + (c + d);
+        et::graph_memory m = et::memory_stats(root);
+        REQUIRE(m.nodes == 7);
+        REQUIRE(m.edges == 6);
+        REQUIRE(m.node_bytes == 7 * et::var::getNodeSize());
+        REQUIRE(m.children_bytes == 0);
+        REQUIRE(m.index_bytes > 0);
+        REQUIRE(m.adjoint_bytes > 0);
+        REQUIRE(m.resident() == m.node_bytes);
+        REQUIRE(m.total() > m.resident());
+    }
+
+    SECTION( "Shared nodes are counted once" ){
+        et::var x(3);
+        et::var root = x * x;
+        for(int i = 0; i < 3; i++)
+            root = root * root;
+        et::graph_memory m = et::memory_stats(root);
+        REQUIRE(m.nodes == 5);
+        REQUIRE(m.edges == 8);
+    }
+
+    SECTION( "Spilled children are counted" ){
+        et::var a(1), b(2), c(3);
+        et::var root(et::op_type::plus, {a, b, c});
+        et::graph_memory m = et::memory_stats(root);
+        REQUIRE(m.nodes == 4);
+        REQUIRE(m.children_bytes >= 3 * sizeof(et::var));
+    }
+}
+
+TEST_CASE( "et::get_memory_counters adds up the counts of every thread.", "[et::get_memory_counters]" ) {
+    et::memory_counters before = et::get_memory_counters();
+    std::vector<std::vector<et::var>> built(4);
+    {
+        // Each thread builds a graph, which another thread then frees.
+        std::vector<std::thread> threads;
+        for(size_t t = 0; t < built.size(); t++){
+            threads.emplace_back([&built, t]{
+                et::var x(1);
+                for(int i = 0; i < 1000; i++)
+                    x = x + 1;
+                built[t].push_back(x);
+            });
+        }
+        for(std::thread& t : threads)
+            t.join();
+    }
+    et::memory_counters during = et::get_memory_counters();
+    REQUIRE(during.live_nodes == before.live_nodes + 4 * 2001);
+    REQUIRE(during.total_nodes == before.total_nodes + 4 * 2001);
+    REQUIRE(during.peak_nodes >= during.live_nodes);
+
+    std::thread([&built]{ built.clear(); }).join();
+    et::memory_counters after = et::get_memory_counters();
+    REQUIRE(after.live_nodes == before.live_nodes);
+    REQUIRE(after.live_bytes == before.live_bytes);
+}
@@ -0,0 +1,203 @@
+#include "catch.hpp"
+#include "../src/utils.h"
+#include <atomic>
+#include <cmath>
+#include <stdexcept>
+
+#define NEW_CASE std::cout<<"======="<<std::endl;
+#define NEW_SEC  std::cout<<"-------"<<std::endl;
+
+TEST_CASE( "et::thread_pool runs every task once.", "[et::thread_pool::run]" ) {
+    et::thread_pool pool(4);
+    REQUIRE(pool.size() == 4);
+
+    SECTION( "Each index is run exactly once." ){
+        std::vector<std::atomic<int>> counts(1000);
+        for(int round = 0; round < 10; round++){
+            pool.run(counts.size(), [&](size_t i){ counts[i]++; });
+            for(auto& c : counts)
+                REQUIRE(c == round + 1);
+        }
+    }
+
+    SECTION( "parallel_for covers the range in disjoint pieces." ){
+        std::vector<int> seen(10000, 0);
+        pool.parallel_for(0, seen.size(), 16, [&](size_t lo, size_t hi){
+            for(size_t i = lo; i < hi; i++)
+                seen[i]++;
+        });
+        for(int s : seen)
+            REQUIRE(s == 1);
+    }
+
+    SECTION( "Ranges smaller than the grain run inline." ){
+        std::thread::id caller = std::this_thread::get_id();
+        pool.parallel_for(0, 100, 1000, [&](size_t, size_t){
+            REQUIRE(std::this_thread::get_id() == caller);
+        });
+    }
+
+    SECTION( "Exceptions are passed on to the caller." ){
+        REQUIRE_THROWS(pool.run(100, [](size_t i){
+            if(i == 42)
+                throw std::invalid_argument("42");
+        }));
+        // The pool is still usable afterwards.
+        std::atomic<int> n(0);
+        pool.run(100, [&](size_t){ n++; });
+        REQUIRE(n == 100);
+    }
+}
+
+TEST_CASE( "et::level_schedule groups the nodes by depth.", "[et::level_schedule::level_schedule]" ) {
+    et::var a(1), b(2), c(3);
+    et::var ab = a * b;
+    et::var root = ab + et::exp(ab) + c;
+    et::graph_index g(root);
+    et::level_schedule s(g);
+
+    REQUIRE(s.numLevels() == 5);
+    REQUIRE(s.levelEnd(0) - s.levelBegin(0) == 3);
+    REQUIRE(s.getLevel(g.find(ab)) == 1);
+    REQUIRE(s.getLevel(g.getRoot()) == 4);
+
+    SECTION( "Nodes only depend on lower levels." ){
+        for(size_t level = 0; level < s.numLevels(); level++){
+            for(const uint32_t* id = s.levelBegin(level); id != s.levelEnd(level); id++){
+                REQUIRE(s.getLevel(*id) == level);
+                for(const uint32_t* c = g.childrenBegin(*id); c != g.childrenEnd(*id); c++)
+                    REQUIRE(s.getLevel(*c) < level);
+            }
+        }
+    }
+}
+
+TEST_CASE( "et::eval can evaluate levels in parallel.", "[et::propagate_levels]" ) {
+    // Many independent sub-expressions, summed pairwise.
+    et::var x(0.5);
+    std::vector<et::var> terms;
+    for(int i = 0; i < 5000; i++)
+        terms.push_back(et::exp(x * i / 5000) + i);
+    while(terms.size() > 1){
+        std::vector<et::var> sums;
+        for(size_t i = 0; i + 1 < terms.size(); i += 2)
+            sums.push_back(terms[i] + terms[i+1]);
+        if(terms.size() % 2)
+            sums.push_back(terms.back());
+        terms = sums;
+    }
+    et::var root = terms[0];
+
+    double expected = et::eval(root);
+    et::thread_pool pool(4);
+
+    SECTION( "The same values come out as evaluating serially." ){
+        x.setValue(0);
+        et::eval(root);
+        x.setValue(0.5);
+        REQUIRE(et::eval(root, pool) == expected);
+    }
+
+    SECTION( "Even when every level is split up." ){
+        et::graph_index g(root);
+        et::level_schedule s(g);
+        x.setValue(0);
+        et::eval(root);
+        x.setValue(0.5);
+        REQUIRE(et::propagate_levels(g, s, pool, 1) == expected);
+        REQUIRE(terms[0].getValue() == expected);
+    }
+}
+
+TEST_CASE( "et::propagate_stealing evaluates as soon as operands are ready.", "[et::propagate_stealing]" ) {
+    // A long chain next to many short independent terms.
+    et::var x(0.5);
+    et::var chain = x;
+    for(int i = 0; i < 2000; i++)
+        chain = chain * 0.999 + x / 1000;
+    et::var root = chain;
+    for(int i = 0; i < 2000; i++)
+        root = root + et::exp(x * i / 2000);
+
+    double expected = et::eval(root);
+    et::thread_pool pool(4);
+
+    for(int round = 0; round < 5; round++){
+        x.setValue(0);
+        et::eval(root);
+        x.setValue(0.5);
+        REQUIRE(et::eval(root, pool, true) == expected);
+    }
+}
+
+TEST_CASE( "et::propagate_stealing rethrows instead of hanging.", "[et::propagate_stealing]" ) {
+    // A none-op with operands cannot be evaluated, and the
+    // nodes above it are left waiting forever.
+    et::var x(0.5), y(2);
+    et::var bad(et::op_type::none, std::vector<et::var>{x, y});
+    et::var root = x;
+    for(int i = 0; i < 100; i++)
+        root = root + bad * i + et::exp(x);
+    et::thread_pool pool(4);
+
+    REQUIRE_THROWS(et::eval(root, pool, true));
+    REQUIRE_THROWS(et::eval(root, pool));
+
+    SECTION( "The pool still works afterwards." ){
+        et::var ok = x * y;
+        REQUIRE(et::eval(ok, pool, true) == 1);
+    }
+}
+
+TEST_CASE( "et::back can backpropagate in parallel.", "[et::backpropagate_stealing]" ) {
+    et::var x(0.5), y(2);
+    // Shared nodes, and operands used twice.
+    et::var s = x * y;
+    et::var fx = et::poly(et::exp(3*x + 1), 2.5)/10 + s*s + x*x;
+    std::vector<et::var> terms;
+    for(int i = 0; i < 500; i++)
+        terms.push_back(fx / (i + 1) + s);
+    et::var root = terms[0];
+    for(int i = 1; i < 500; i++)
+        root = root + terms[i];
+    et::eval(root);
+
+    // root = sum_i fx/(i+1) + s
+    double h = 0;
+    for(int i = 0; i < 500; i++)
+        h += 1.0 / (i + 1);
+    double sv = 0.5 * 2;
+    std::unordered_map<et::var, double> expected = {
+        { x, h * ((3.0/4)*std::exp(7.5*0.5 + 2.5) + 2*sv*2 + 2*0.5) + 500*2 },
+        { y, h * 2*sv*0.5 + 500*0.5 },
+        { s, h * 2*sv + 500 },
+    };
+    std::unordered_map<et::var, double> m = {
+        { x, 0 }, { y, 0 }, { s, 0 },
+    };
+
+    et::thread_pool pool(4);
+    for(int round = 0; round < 5; round++){
+        et::back(root, m, pool);
+        for(auto& p : expected)
+            REQUIRE(std::abs(m[p.first] - p.second) < 1e-9 * std::abs(p.second));
+    }
+
+    SECTION( "The adjoints are indexed by id." ){
+        et::graph_index g(root);
+        std::vector<double> adjoints = et::backpropagate_stealing(g, pool);
+        REQUIRE(adjoints[g.getRoot()] == 1);
+        REQUIRE(adjoints[g.find(x)] == m[x]);
+    }
+
+    SECTION( "Only the root is seeded in an index over several roots." ){
+        et::var other = s * 3 + y;
+        et::eval(other);
+        et::graph_index g(std::vector<et::var>{ other, root });
+        REQUIRE(g.getNode(g.getRoot()) == root);
+        std::vector<double> adjoints = et::backpropagate_stealing(g, pool);
+        REQUIRE(adjoints[g.find(other)] == 0);
+        REQUIRE(adjoints[g.find(x)] == m[x]);
+        REQUIRE(adjoints[g.find(s)] == m[s]);
+    }
+}
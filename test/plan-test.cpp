@@ -0,0 +1,192 @@
+#include "catch.hpp"
+#include "../src/utils.h"
+#include <cmath>
+
+#define NEW_CASE std::cout<<"======="<<std::endl;
+#define NEW_SEC  std::cout<<"-------"<<std::endl;
+
+TEST_CASE( "et::compile lays the graph out in order.", "[et::compile]" ) {
+    et::var a(10), b(5), c(15), d(2);
+    et::var a_b = a + b;
+    et::var root = a_b * (c + d);
+    et::plan p = et::compile(root);
+
+    REQUIRE(p.size() == 7);
+    REQUIRE(p.getRoot() == root);
+    REQUIRE(p.getLeaves().size() == 4);
+
+    SECTION( "Operands come before the instructions reading them." ){
+        const std::vector<uint32_t>& offsets = p.getArgOffsets();
+        const std::vector<uint32_t>& args = p.getArgs();
+        REQUIRE(p.getOps().size() == p.size());
+        REQUIRE(offsets.size() == p.size() + 1);
+        for(uint32_t i = 0; i < p.size(); i++){
+            for(uint32_t e = offsets[i]; e < offsets[i+1]; e++)
+                REQUIRE(args[e] < i);
+        }
+    }
+
+    SECTION( "Shared nodes are compiled once." ){
+        et::var x(3);
+        et::var y = x * x;
+        et::plan q = et::compile(y * y);
+        REQUIRE(q.size() == 3);
+        REQUIRE(q.getLeaves().size() == 1);
+    }
+
+    SECTION( "Only unary and binary operators can be compiled." ){
+        et::var w(et::op_type::plus, {a, b, c});
+        REQUIRE_THROWS(et::compile(w));
+    }
+}
+
+TEST_CASE( "et::plan can be evaluated repeatedly.", "[et::plan::eval]" ) {
+    SECTION( "et::plan evaluates a+b+c+d" ) {
+        et::var a(10), b(5), c(15), d(2);
+        et::var root = (a + b) + (c + d);
+        et::plan p = et::compile(root);
+        REQUIRE(p.eval() == 32);
+        REQUIRE(p.getValues().back() == 32);
+    }
+
+    SECTION( "et::plan only writes to the graph in store()" ) {
+        et::var a(10), b(5);
+        et::var a_b = a * b;
+        et::var root = a_b + 1;
+        et::plan p = et::compile(root);
+        REQUIRE(p.eval() == 51);
+        REQUIRE(a_b.getValue() == 0);
+        REQUIRE(root.getValue() == 0);
+        p.store();
+        REQUIRE(a_b.getValue() == 50);
+        REQUIRE(root.getValue() == 51);
+        REQUIRE(a.getValue() == 10);
+    }
+
+    SECTION( "et::plan picks up new leaf values" ) {
+        et::var x(2);
+        et::var y = x + 1;
+        et::var fx = et::poly(et::exp(3*x), 2) + y;
+        et::plan p = et::compile(fx);
+        for(int i = 0; i < 5; i++){
+            x.setValue(i * 0.1);
+            double expected = std::exp(6*i*0.1) + i*0.1 + 1;
+            REQUIRE(std::abs(p.eval() - expected) < 1e-10);
+            p.store();
+            REQUIRE(std::abs(fx.getValue() - expected) < 1e-10);
+            REQUIRE(y.getValue() == i*0.1 + 1);
+        }
+    }
+
+    SECTION( "et::plan agrees with et::eval" ) {
+        et::var a(3), b(2.5);
+        et::var root = a*et::exp(a) - 1/(1+b);
+        et::plan p = et::compile(root);
+        a.setValue(0.5);
+        double planned = p.eval();
+        REQUIRE(planned == et::eval(root, false));
+    }
+}
+
+TEST_CASE( "et::plan can re-evaluate incrementally.", "[et::plan::update]" ) {
+    et::var a(1), b(2), c(3);
+    et::var ab = a * b;
+    et::var bc = b + c;
+    et::var root = ab + et::exp(c) * bc;
+    et::plan p = et::compile(root);
+    double first = p.update();
+    // ab, bc, exp(c), exp(c)*bc and root.
+    REQUIRE(p.numRecomputed() == 5);
+    REQUIRE(first == p.eval());
+
+    SECTION( "Nothing changed, nothing recomputed." ){
+        ab.setValue(-1); // not a leaf; update() does not look at it.
+        p.update();
+        REQUIRE(p.numRecomputed() == 0);
+    }
+
+    SECTION( "Only the cone of the changed leaf is recomputed." ){
+        a.setValue(10);
+        double res = p.update();
+        REQUIRE(res == 20 + std::exp(3) * 5);
+        // ab and root, not the 3 nodes under c.
+        REQUIRE(p.numRecomputed() == 2);
+        p.store();
+        REQUIRE(ab.getValue() == 20);
+        REQUIRE(bc.getValue() == 5);
+    }
+
+    SECTION( "update() agrees with eval() after several changes." ){
+        for(int i = 0; i < 5; i++){
+            b.setValue(i);
+            if(i % 2)
+                c.setValue(-i);
+            double incremental = p.update();
+            REQUIRE(incremental == p.eval());
+            p.store();
+            REQUIRE(root.getValue() == incremental);
+        }
+    }
+}
+
+TEST_CASE( "et::plan can evaluate many rows at once.", "[et::plan::eval]" ) {
+    et::var x(0), y(0), c(3);
+    et::var fx = et::poly(et::exp(x / 10), y) * c - x*x + 1 / (y + 1);
+    et::plan p = et::compile(fx);
+
+    // More rows than fit in one chunk, and not a multiple of it.
+    const size_t rows = 1001;
+    std::vector<double> xs(rows), ys(rows), out(rows);
+    for(size_t i = 0; i < rows; i++){
+        xs[i] = i * 0.01;
+        ys[i] = 2 - i * 0.001;
+    }
+
+    SECTION( "Every row agrees with evaluating it on its own." ){
+        p.eval({ {x, xs.data()}, {y, ys.data()} }, rows, out.data());
+        for(size_t i = 0; i < rows; i++){
+            x.setValue(xs[i]);
+            y.setValue(ys[i]);
+            REQUIRE(std::abs(out[i] - et::eval(fx)) < 1e-12 * std::abs(out[i]));
+        }
+    }
+
+    SECTION( "Unbound leaves keep their value for every row." ){
+        y.setValue(2);
+        p.eval({ {x, xs.data()} }, rows, out.data());
+        for(size_t i = 0; i < rows; i += 100){
+            x.setValue(xs[i]);
+            REQUIRE(std::abs(out[i] - et::eval(fx)) < 1e-12 * std::abs(out[i]));
+        }
+    }
+
+    SECTION( "The graph is left alone." ){
+        x.setValue(1);
+        y.setValue(1);
+        double before = et::eval(fx);
+        p.eval({ {x, xs.data()}, {y, ys.data()} }, rows, out.data());
+        REQUIRE(fx.getValue() == before);
+    }
+
+    SECTION( "Only leaves can be bound." ){
+        et::var other(1);
+        REQUIRE_THROWS(p.eval({ {fx, xs.data()} }, rows, out.data()));
+        REQUIRE_THROWS(p.eval({ {other, xs.data()} }, rows, out.data()));
+    }
+}
+
+TEST_CASE( "et::plan does not evaluate anything until asked to.", "[et::compile]" ) {
+    et::var x(2);
+    et::var y = et::exp(x) * x;
+    et::plan p = et::compile(y);
+    REQUIRE(y.getValue() == 0);
+    REQUIRE(p.eval() == std::exp(2) * 2);
+
+    SECTION( "Plans are not limited in number like tapes." ){
+        std::vector<et::plan> plans;
+        // More than the 65536 tapes that can be alive at once.
+        for(uint32_t i = 0; i < 65536 + 10; i++)
+            plans.push_back(et::compile(y));
+        REQUIRE(plans.back().eval() == std::exp(2) * 2);
+    }
+}
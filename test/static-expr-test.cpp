@@ -0,0 +1,72 @@
+#include "catch.hpp"
+#include "../src/static_expr.h"
+#include "../src/utils.h"
+#include "../src/memory.h"
+#include <cmath>
+
+#define NEW_CASE std::cout<<"======="<<std::endl;
+#define NEW_SEC  std::cout<<"-------"<<std::endl;
+
+TEST_CASE( "et::static_expr evaluates formulas.", "[et::static_expr::eval]" ) {
+    et::static_var<0> x;
+    et::static_var<1> y;
+
+    SECTION( "Operators between inputs and constants." ){
+        double in[2] = {3, 2};
+        REQUIRE(et::eval(x + y, in) == 5);
+        REQUIRE(et::eval(x - 1, in) == 2);
+        REQUIRE(et::eval(2 * y, in) == 4);
+        REQUIRE(et::eval(1 / y, in) == 0.5);
+        REQUIRE(et::eval(et::poly(x, y), in) == 9);
+        REQUIRE(et::eval(et::exp(x - x), in) == 1);
+    }
+
+    SECTION( "The same value comes out as from an et::var graph." ){
+        auto f = et::poly(et::exp(3*x + 1), 2.5)/10 + x*y - y/(x + 1);
+        et::var vx(0.5), vy(2);
+        et::var vf = et::poly(et::exp(3*vx + 1), 2.5)/10 + vx*vy - vy/(vx + 1);
+        double in[2] = {0.5, 2};
+        REQUIRE(et::eval(f, in) == et::eval(vf));
+    }
+
+    SECTION( "No node is allocated." ){
+        size_t before = et::get_memory_counters().total_nodes;
+        auto f = et::exp(x * y) + x;
+        double in[2] = {1, 2};
+        double grad[2] = {0, 0};
+        et::back(f, in, grad);
+        REQUIRE(et::get_memory_counters().total_nodes == before);
+    }
+}
+
+TEST_CASE( "et::static_expr finds the derivatives.", "[et::static_expr::back]" ) {
+    et::static_var<0> x;
+    et::static_var<1> y;
+
+    SECTION( "d/dx of poly(exp(3x+1), 2.5)/10 + 10" ){
+        auto f = et::poly(et::exp(3*x + 1), 2.5)/10 + 10;
+        double in[1] = {0.5};
+        double grad[1] = {0};
+        double v = et::back(f, in, grad);
+        REQUIRE(v == et::eval(f, in));
+        REQUIRE(std::abs(grad[0] - (3.0/4)*std::exp(7.5*0.5 + 2.5)) < 1e-10);
+    }
+
+    SECTION( "Inputs used several times add up." ){
+        // f = x^2 y + x/y - y
+        auto f = x*x*y + x/y - y;
+        double in[2] = {3, 2};
+        double grad[2] = {0, 0};
+        et::back(f, in, grad);
+        REQUIRE(std::abs(grad[0] - (2*3*2 + 1.0/2)) < 1e-12);
+        REQUIRE(std::abs(grad[1] - (9 - 3.0/4 - 1)) < 1e-12);
+    }
+
+    SECTION( "No gradient flows into the exponent of poly()." ){
+        double in[2] = {2, 3};
+        double grad[2] = {0, 0};
+        et::back(et::poly(x, y), in, grad);
+        REQUIRE(grad[0] == 12);
+        REQUIRE(grad[1] == 0);
+    }
+}
@@ -0,0 +1,229 @@
+#include "catch.hpp"
+#include "../src/tape.h"
+#include <cmath>
+
+#define NEW_CASE std::cout<<"======="<<std::endl;
+#define NEW_SEC  std::cout<<"-------"<<std::endl;
+
+TEST_CASE( "et::tape records operators in order.", "[et::tape::push]" ) {
+    et::tape t;
+    et::tvar a = t.variable(10), b = t.variable(5);
+    et::tvar c = a + b;
+
+    REQUIRE(t.size() == 3);
+    REQUIRE(c.getIndex() == 2);
+    REQUIRE(c.getOp() == et::op_type::plus);
+    REQUIRE(t.numArgs(2) == 2);
+    REQUIRE(t.getArgs(2)[0] == a.getIndex());
+    REQUIRE(t.getArgs(2)[1] == b.getIndex());
+
+    SECTION( "Values are computed eagerly while recording." ){
+        REQUIRE(c.getValue() == 15);
+    }
+
+    SECTION( "Unary operators have no second operand." ){
+        et::tvar d = et::exp(a);
+        REQUIRE(t.numArgs(d.getIndex()) == 1);
+        REQUIRE(t.getArgs(d.getIndex())[0] == a.getIndex());
+    }
+
+    SECTION( "Constants are recorded as leaves." ){
+        et::tvar d = 3 * a;
+        REQUIRE(t.size() == 5);
+        REQUIRE(t.getOp(3) == et::op_type::none);
+        REQUIRE(t.numArgs(3) == 0);
+        REQUIRE(t.getValue(3) == 3);
+        REQUIRE(d.getValue() == 30);
+    }
+
+    SECTION( "tvars from different tapes cannot be mixed." ){
+        et::tape u;
+        et::tvar d = u.variable(1);
+        REQUIRE_THROWS(a + d);
+    }
+    SECTION( "tvars kept across clear() are caught." ){
+        et::tvar root = a + b;
+        t.clear();
+        REQUIRE_THROWS(a.getValue());
+        REQUIRE_THROWS(root.setValue(1));
+        REQUIRE_THROWS(a + b);
+        REQUIRE_THROWS(t.backward(root));
+        REQUIRE_THROWS(t.getDerivative(a));
+    }
+
+    SECTION( "Operators are checked against their number of operands." ){
+        REQUIRE_THROWS(t.push(et::op_type::exponent, a, b));
+        REQUIRE_THROWS(t.push(et::op_type::plus, a));
+        REQUIRE_THROWS(t.push(et::op_type::none, a));
+        REQUIRE(t.size() == 3);
+        REQUIRE(t.getArgs().size() == 2);
+    }
+
+    SECTION( "A push that throws leaves the tape as it was." ){
+        REQUIRE_THROWS(t.push(et::op_type::none, a, b));
+        REQUIRE(t.size() == 3);
+        REQUIRE(t.getArgs().size() == 2);
+        REQUIRE(t.getArgOffsets().size() == 4);
+
+        et::tvar d = et::exp(b);
+        REQUIRE(t.numArgs(d.getIndex()) == 1);
+        REQUIRE(t.getArgs(d.getIndex())[0] == b.getIndex());
+        t.backward(d * c);
+        REQUIRE(std::abs(t.getDerivative(b) - (std::exp(5) + std::exp(5) * 15)) < 1e-9);
+    }
+}
+
+TEST_CASE( "et::tape stores its entries as arrays.", "[et::tape::getOps]" ) {
+    et::tape t;
+    et::tvar a = t.variable(2), b = t.variable(3);
+    et::exp(a * b);
+
+    REQUIRE(t.getOps().size() == 4);
+    REQUIRE(t.getValues().size() == 4);
+    REQUIRE(t.getArgOffsets().size() == 5);
+    REQUIRE(t.getArgs().size() == 3);
+    REQUIRE(t.getOps()[3] == et::op_type::exponent);
+    REQUIRE(t.getValues()[2] == 6);
+
+    SECTION( "clear() empties every array." ){
+        t.clear();
+        REQUIRE(t.size() == 0);
+        REQUIRE(t.getArgs().empty());
+        REQUIRE(t.getArgOffsets().size() == 1);
+    }
+}
+
+TEST_CASE( "et::tape can evaluate forward.", "[et::tape::forward]" ) {
+    SECTION( "et::tape evaluates a+b+c+d" ) {
+        et::tape t;
+        et::tvar a = t.variable(10), b = t.variable(5), c = t.variable(15), d = t.variable(2);
+        et::tvar root = (a + b) + (c + d);
+        REQUIRE(t.forward() == 32);
+        REQUIRE(root.getValue() == 32);
+    }
+
+    SECTION( "et::tape evaluates poly(a,b)/c" ) {
+        et::tape t;
+        et::tvar a = t.variable(2), b = t.variable(3), c = t.variable(8);
+        et::poly(a,b) / c;
+        REQUIRE(t.forward() == 1);
+    }
+
+    SECTION( "et::tape re-evaluates after a leaf changes" ) {
+        et::tape t;
+        et::tvar a = t.variable(3), b = t.variable(2.5);
+        et::tvar root = et::exp(a) - b;
+        REQUIRE(root.getValue() == std::exp(3) - 2.5);
+        a.setValue(1);
+        REQUIRE(t.forward() == std::exp(1) - 2.5);
+        REQUIRE(root.getValue() == std::exp(1) - 2.5);
+    }
+}
+
+TEST_CASE( "et::tape can find the derivatives.", "[et::tape::backward]" ) {
+    SECTION( "et::tape evaluates poly(a,b)/c" ) {
+        et::tape t;
+        et::tvar a = t.variable(2), b = t.variable(3), c = t.variable(8);
+        et::tvar root = et::poly(a,b) / c;
+        t.backward(root);
+        REQUIRE(t.getDerivative(a) == (12.0/8));
+        REQUIRE(t.getDerivative(b) == 0);
+        REQUIRE(t.getDerivative(c) == (-8.0)/(64));
+    }
+
+    SECTION( "et::tape evaluates a*exp(a) - b" ) {
+        et::tape t;
+        et::tvar a = t.variable(3), b = t.variable(2.5);
+        et::tvar root = a*et::exp(a) - b;
+        t.backward(root);
+        REQUIRE(t.getDerivative(a) == std::exp(3) + std::exp(3)*3);
+        REQUIRE(t.getDerivative(b) == -1);
+    }
+
+    SECTION( "et::tape evaluates sigmoid(a)" ) {
+        et::tape t;
+        et::tvar a = t.variable(3);
+        et::tvar root = 1/(1+et::exp(-1*a));
+        t.backward(root);
+        double sigm = 1/(1+std::exp(-3));
+        double grad = sigm * (1-sigm);
+        REQUIRE(std::abs(t.getDerivative(a)-grad) < 1e-10);
+    }
+
+    SECTION( "et::tape ignores records after the root" ) {
+        et::tape t;
+        et::tvar a = t.variable(3), b = t.variable(4);
+        et::tvar root = a * b;
+        et::tvar later = root * a;
+        t.backward(root);
+        REQUIRE(t.getDerivative(a) == 4);
+        REQUIRE(t.getDerivative(later) == 0);
+    }
+}
+
+TEST_CASE( "et::tvar is a plain handle.", "[et::tvar::tvar]" ) {
+    et::tape t;
+    et::tvar a = t.variable(1);
+
+    SECTION( "et::tvar knows its tape by id." ){
+        REQUIRE(a.getTapeId() == t.getId());
+        REQUIRE(&a.getTape() == &t);
+        REQUIRE(&et::tape::get(t.getId()) == &t);
+    }
+
+    SECTION( "Every live tape has its own id." ){
+        et::tape u;
+        REQUIRE(u.getId() != t.getId());
+    }
+
+    SECTION( "et::tvar cannot reach a destroyed tape." ){
+        et::tvar* b;
+        {
+            et::tape u;
+            b = new et::tvar(u.variable(2));
+        }
+        REQUIRE_THROWS(b->getValue());
+        delete b;
+    }
+
+    SECTION( "et::tvar does not reach a newer tape given the same slot." ){
+        const uint32_t slot = et::tape::max_tapes - 1;
+        uint32_t id;
+        et::tvar* b;
+        {
+            et::tape u;
+            id = u.getId();
+            b = new et::tvar(u.variable(2));
+        }
+        // Slots are reused oldest first, so cycle until this one comes back.
+        bool reused = false;
+        for(int i = 0; i < 1000 && !reused; i++){
+            et::tape w;
+            w.variable(5);
+            if((w.getId() & slot) == (id & slot)){
+                reused = true;
+                REQUIRE(w.getId() != id);
+                REQUIRE_THROWS(b->getValue());
+            }
+        }
+        REQUIRE(reused);
+        delete b;
+    }
+}
+
+TEST_CASE( "et::tape can be moved.", "[et::tape::tape]" ) {
+    et::tape t;
+    et::tvar a = t.variable(2);
+    et::tvar b = a * 3;
+    uint32_t id = t.getId();
+
+    et::tape u(std::move(t));
+    REQUIRE(u.getId() == id);
+    REQUIRE(&b.getTape() == &u);
+    REQUIRE(b.getValue() == 6);
+
+    et::tape w;
+    w = std::move(u);
+    REQUIRE(&b.getTape() == &w);
+    REQUIRE(w.forward() == 6);
+}
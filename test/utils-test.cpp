@@ -10,6 +10,21 @@ TEST_CASE("et::eval can forward propagate.", "[et::eval]"){
     REQUIRE(et::eval(fx,true) - (std::exp(3*2)*std::exp(3*2)+10) < 1e-10);
 }
 
+TEST_CASE("et::eval can forward propagate very deep graphs.", "[et::eval]"){
+    // A million time steps of x_{t+1} = x_t + h * x_t.
+    const int steps = 1000000;
+    et::var h(1e-6), x0(1);
+    et::var x = x0;
+    for(int i = 0; i < steps; i++)
+        x = x + h * x;
+    REQUIRE(std::abs(et::eval(x) - std::exp(1)) < 1e-5);
+
+    SECTION( "The same answer comes out twice." ){
+        x0.setValue(2);
+        REQUIRE(std::abs(et::eval(x) - 2*std::exp(1)) < 1e-5);
+    }
+}
+
 TEST_CASE("et::back can back propagate.", "[et::back]"){
     et::var x(0.5);
     et::var fx = et::poly(et::exp(3*x + 1), 2.5)/10 + 10;
@@ -35,3 +50,145 @@ TEST_CASE("et::back can back propagate with nonconstqualify optimize.", "[et::ba
     
     REQUIRE(m[x] - ((3.0/4)*std::exp(7.5*0.5 + 2.5)) < 1e-10);
 }
+
+TEST_CASE("et::back can write the gradient into an array.", "[et::back]"){
+    et::var x(0.5), y(2), z(3);
+    et::var fx = x * y + et::exp(x) + x;
+    std::vector<et::var> leaves = {y, x, z};
+    double grad[3] = {-1, -1, -1};
+
+    et::eval(fx, true);
+    et::back(fx, leaves, grad);
+
+    REQUIRE(grad[0] == 0.5);
+    REQUIRE(std::abs(grad[1] - (2 + std::exp(0.5) + 1)) < 1e-10);
+    SECTION( "Leaves outside of the graph get 0." ){
+        REQUIRE(grad[2] == 0);
+    }
+}
+
+TEST_CASE("et::jacobian finds the derivatives of every root.", "[et::jacobian]"){
+    et::var x(0.5), y(2), z(3);
+    et::var xy = x * y;
+    std::vector<et::var> roots = {
+        xy + z,
+        et::exp(xy),
+        x / z,
+        et::poly(y, 3) - x,
+    };
+    std::vector<et::var> leaves = {x, y, z};
+
+    // Row-major, 4 x 3.
+    double e = std::exp(1);
+    std::vector<double> expected = {
+        2, 0.5, 1,
+        2*e, 0.5*e, 0,
+        1.0/3, 0, -0.5/9,
+        -1, 12, 0,
+    };
+
+    SECTION( "In reverse mode." ){
+        std::vector<double> j = et::jacobian(roots, leaves, et::jacobian_mode::reverse);
+        REQUIRE(j.size() == expected.size());
+        for(size_t k = 0; k < j.size(); k++)
+            REQUIRE(std::abs(j[k] - expected[k]) < 1e-10);
+    }
+
+    SECTION( "In forward mode." ){
+        std::vector<double> j = et::jacobian(roots, leaves, et::jacobian_mode::forward);
+        REQUIRE(j.size() == expected.size());
+        for(size_t k = 0; k < j.size(); k++)
+            REQUIRE(std::abs(j[k] - expected[k]) < 1e-10);
+    }
+
+    SECTION( "Leaves outside of the graph get 0." ){
+        et::var w(1);
+        std::vector<double> j = et::jacobian(roots, {w, x});
+        REQUIRE(j.size() == 8);
+        REQUIRE(j[0] == 0);
+        REQUIRE(j[1] == 2);
+    }
+
+    SECTION( "Only leaves can be differentiated against." ){
+        REQUIRE_THROWS(et::jacobian(roots, {xy}));
+    }
+
+    SECTION( "Without roots, the jacobian is empty." ){
+        REQUIRE(et::jacobian({}, {x, y}).empty());
+    }
+}
+
+TEST_CASE("et::jacobian agrees with et::back over many blocks of seeds.", "[et::jacobian]"){
+    // 20 roots over 11 leaves, which does not fill the last block.
+    std::vector<et::var> leaves;
+    for(int i = 0; i < 11; i++)
+        leaves.push_back(et::var(0.1 * (i + 1)));
+    std::vector<et::var> roots;
+    et::var acc = leaves[0];
+    for(int i = 0; i < 20; i++){
+        acc = acc * leaves[i % 11] + et::exp(leaves[(i * 7) % 11]) / leaves[(i + 3) % 11];
+        roots.push_back(acc);
+    }
+
+    std::vector<double> fwd = et::jacobian(roots, leaves, et::jacobian_mode::forward);
+    std::vector<double> rev = et::jacobian(roots, leaves, et::jacobian_mode::reverse);
+    for(size_t i = 0; i < roots.size(); i++){
+        std::vector<double> grad(leaves.size());
+        et::eval(roots[i]);
+        et::back(roots[i], leaves, grad.data());
+        for(size_t j = 0; j < leaves.size(); j++){
+            double tol = 1e-10 * (1 + std::abs(grad[j]));
+            REQUIRE(std::abs(fwd[i * leaves.size() + j] - grad[j]) < tol);
+            REQUIRE(std::abs(rev[i * leaves.size() + j] - grad[j]) < tol);
+        }
+    }
+}
+
+TEST_CASE("et::back uses the values of the last et::eval.", "[et::back]"){
+    et::var x(2), a(2), b(3);
+    et::var y = et::exp(x);
+    et::var q = a / b;
+
+    SECTION( "Operators start out at 0 until evaluated." ){
+        REQUIRE(y.getValue() == 0);
+        REQUIRE(q.getValue() == 0);
+    }
+
+    SECTION( "After eval, the derivatives are exact." ){
+        std::unordered_map<et::var, double> m = { {x, 0} };
+        et::eval(y);
+        et::back(y, m);
+        REQUIRE(std::abs(m[x] - std::exp(2)) < 1e-10);
+
+        std::unordered_map<et::var, double> n = { {b, 0} };
+        et::eval(q);
+        et::back(q, n);
+        REQUIRE(std::abs(n[b] - (-2.0/9)) < 1e-10);
+    }
+
+    SECTION( "Changing a leaf calls for another eval." ){
+        std::unordered_map<et::var, double> m = { {x, 0} };
+        et::eval(y);
+        x.setValue(3);
+        et::eval(y);
+        et::back(y, m);
+        REQUIRE(std::abs(m[x] - std::exp(3)) < 1e-10);
+    }
+}
+
+TEST_CASE("et::back can reuse a graph_index.", "[et::back]"){
+    et::var x(0.5), y(2), z(3);
+    et::var fx = x * y + et::exp(x) + x;
+    et::graph_index g(fx);
+    std::vector<uint32_t> ids = {g.find(y), g.find(x), g.find(z)};
+    double grad[3] = {-1, -1, -1};
+
+    for(int i = 1; i <= 3; i++){
+        x.setValue(0.5 * i);
+        et::eval(fx);
+        et::back(g, ids, grad);
+        REQUIRE(grad[0] == 0.5 * i);
+        REQUIRE(std::abs(grad[1] - (2 + std::exp(0.5 * i) + 1)) < 1e-10);
+        REQUIRE(grad[2] == 0);
+    }
+}
@@ -48,7 +48,7 @@ TEST_CASE( "et::var's set/get functions work.", "[et::var::get*/set*]" ){
         REQUIRE(x.getOp() == et::op_type::polynomial);
     }
 
-    SECTION( "et::var getChildren/Parents()" ){
+    SECTION( "et::var getChildren()" ){
         et::var a(1),b(3),c(2),d(4);
         et::var x = a + b;
         et::var y = c + d;
@@ -63,17 +63,7 @@ TEST_CASE( "et::var's set/get functions work.", "[et::var::get*/set*]" ){
         REQUIRE(x.getUseCount() == 2);
         REQUIRE(z.getUseCount() == 1);
         REQUIRE(w.getUseCount() == 1);
-        {
-            std::vector<et::var> parents = y.getParents();
-
-            REQUIRE(parents.size() == 2);
-            REQUIRE(parents[0].getValue() == 0.5);
-            REQUIRE(parents[1].getValue() == 0.2);
-            REQUIRE(z.getUseCount() == 2);
-            REQUIRE(w.getUseCount() == 2);
-        }
-        REQUIRE(z.getUseCount() == 1);
-        REQUIRE(w.getUseCount() == 1);
+        REQUIRE(y.getUseCount() == 3);
     }
 }
 
@@ -100,6 +90,36 @@ TEST_CASE( "et::var can be added.", "[et::var::operator+]" ) {
         }
     }
 
+    SECTION( "The children are stored inline." ){
+        et::var z = x + y;
+        REQUIRE(!z.getChildren().spilled());
+
+        SECTION( "Past 2 children they spill onto the heap." ){
+            et::var w(et::op_type::plus, {x, y, z});
+            REQUIRE(w.getChildren().spilled());
+            REQUIRE(w.getChildren().size() == 3);
+            REQUIRE(w.getChildren()[2].getChildren()[1].getValue() == 20);
+            REQUIRE(z.getUseCount() == 2);
+
+            et::var c = w.clone();
+            REQUIRE(c.getChildren().size() == 3);
+            REQUIRE(z.getUseCount() == 3);
+        }
+
+        SECTION( "An element can be appended to the vector it is in." ){
+            et::var::children_type& children = z.getChildren();
+            children.push_back(children[0]);
+            REQUIRE(children.spilled());
+            REQUIRE(children.size() == 3);
+            REQUIRE(children[2] == x);
+            children.emplace_back(children[1]);
+            children.emplace_back(children[3]);
+            REQUIRE(children.size() == 5);
+            REQUIRE(children[4] == y);
+            REQUIRE(x.getUseCount() == 3);
+        }
+    }
+
     SECTION( "Left add 10 + x." ){
         et::var z = 15 + x;
 
@@ -161,3 +181,23 @@ TEST_CASE( "et::var can be exponentiated.", "[et::var::exp]" ) {
         REQUIRE(x.getChildren()[0].getChildren()[0].getUseCount() == 1);
     }
 }
+
+TEST_CASE( "et::op_table describes every operator.", "[et::getOpInfo]" ) {
+    // The table is usable at compile time.
+    static_assert(et::numOpArgs(et::op_type::plus) == 2, "plus is binary");
+    static_assert(et::numOpArgs(et::op_type::exponent) == 1, "exp is unary");
+
+    REQUIRE(et::numOpArgs(et::op_type::polynomial) == 2);
+    REQUIRE(et::numOpArgs(et::op_type::none) == 0);
+    REQUIRE(et::getOpInfo(et::op_type::multiply).commutative);
+    REQUIRE(!et::getOpInfo(et::op_type::divide).commutative);
+    REQUIRE(!et::getOpInfo(et::op_type::polynomial).differentiable);
+    REQUIRE(std::string(et::getOpInfo(et::op_type::minus).name) == "minus");
+
+    SECTION( "The arity matches what the operators build." ){
+        et::var x(2), y(3);
+        REQUIRE(et::poly(x, y).getChildren().size() == et::numOpArgs(et::op_type::polynomial));
+        REQUIRE(et::exp(x).getChildren().size() == et::numOpArgs(et::op_type::exponent));
+        REQUIRE((x / y).getChildren().size() == et::numOpArgs(et::op_type::divide));
+    }
+}